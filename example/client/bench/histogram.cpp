@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "histogram.hpp"
+#include <cmath>
+
+histogram::
+histogram()
+    : counts_(size)
+{
+}
+
+void
+histogram::
+record(std::uint64_t v) noexcept
+{
+    ++counts_[index(v)];
+    ++count_;
+    sum_ += static_cast<double>(v);
+    if(v < min_)
+        min_ = v;
+    if(v > max_)
+        max_ = v;
+}
+
+void
+histogram::
+merge(histogram const& other) noexcept
+{
+    for(std::size_t i = 0; i < size; ++i)
+        counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if(other.min_ < min_)
+        min_ = other.min_;
+    if(other.max_ > max_)
+        max_ = other.max_;
+}
+
+double
+histogram::
+mean() const noexcept
+{
+    if(count_ == 0)
+        return 0;
+    return sum_ / static_cast<double>(count_);
+}
+
+std::uint64_t
+histogram::
+percentile(double p) const noexcept
+{
+    if(count_ == 0)
+        return 0;
+    auto rank = static_cast<std::uint64_t>(
+        std::ceil(p / 100 * static_cast<double>(count_)));
+    if(rank == 0)
+        rank = 1;
+    std::uint64_t seen = 0;
+    for(std::size_t i = 0; i < size; ++i)
+    {
+        seen += counts_[i];
+        if(seen >= rank)
+        {
+            // never report beyond what was seen
+            auto const v = highest(i);
+            return v < max_ ? v : max_;
+        }
+    }
+    return max_;
+}
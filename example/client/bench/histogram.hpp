@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_BENCH_HISTOGRAM_HPP
+#define BOOST_HTTP_IO_EXAMPLE_BENCH_HISTOGRAM_HPP
+
+#include "../../common/log_linear.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** A high dynamic range histogram of latencies
+
+    Values are nanoseconds. Each power of two is
+    split into 128 linear sub-buckets, so any
+    recorded value is reported within 1% of its
+    true value across the full 64-bit range, using
+    a fixed 60KB of counts.
+
+    A histogram belongs to one thread. Results
+    from several threads are combined with
+    @ref merge once they have stopped.
+*/
+class histogram : log_linear<7>
+{
+public:
+    using log_linear::sub_bits;
+    using log_linear::size;
+
+    histogram();
+
+    void
+    record(std::uint64_t v) noexcept;
+
+    void
+    merge(histogram const& other) noexcept;
+
+    std::uint64_t
+    count() const noexcept
+    {
+        return count_;
+    }
+
+    std::uint64_t
+    min() const noexcept
+    {
+        return count_ ? min_ : 0;
+    }
+
+    std::uint64_t
+    max() const noexcept
+    {
+        return max_;
+    }
+
+    double
+    mean() const noexcept;
+
+    /** Return the value at a percentile
+
+        @param p A percentile from 0 to 100.
+    */
+    std::uint64_t
+    percentile(double p) const noexcept;
+
+private:
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t count_ = 0;
+    std::uint64_t min_ = ~std::uint64_t(0);
+    std::uint64_t max_ = 0;
+    double sum_ = 0;
+};
+
+#endif
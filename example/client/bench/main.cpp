@@ -0,0 +1,531 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "histogram.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/http_io.hpp>
+#include <boost/http_proto.hpp>
+#include <boost/core/detail/string_view.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace buffers = boost::buffers;
+namespace core = boost::core;
+namespace http_io = boost::http_io;
+namespace http_proto = boost::http_proto;
+using tcp = boost::asio::ip::tcp;
+using namespace std::placeholders;
+
+using clock_type = std::chrono::steady_clock;
+
+//------------------------------------------------
+
+struct options
+{
+    std::string host;
+    std::string port;
+    std::string target = "/";
+    std::size_t connections = 64;
+    std::size_t threads = 1;
+    std::chrono::seconds duration{10};
+
+    // total requests per second, or zero for
+    // a closed loop which sends as fast as
+    // responses arrive
+    double rate = 0;
+};
+
+// Counters and latencies of one thread
+struct stats
+{
+    histogram latency;
+    std::uint64_t requests = 0;
+    std::uint64_t non_2xx = 0;
+    std::uint64_t bytes_in = 0;
+    std::uint64_t bytes_out = 0;
+    std::uint64_t connect_errors = 0;
+    std::uint64_t read_errors = 0;
+    std::uint64_t write_errors = 0;
+
+    void
+    merge(stats const& other)
+    {
+        latency.merge(other.latency);
+        requests += other.requests;
+        non_2xx += other.non_2xx;
+        bytes_in += other.bytes_in;
+        bytes_out += other.bytes_out;
+        connect_errors += other.connect_errors;
+        read_errors += other.read_errors;
+        write_errors += other.write_errors;
+    }
+};
+
+// Discards response bodies of any size
+struct null_sink : http_proto::sink
+{
+    results
+    on_write(buffers::const_buffer cb, bool) override
+    {
+        return { {}, cb.size() };
+    }
+};
+
+//------------------------------------------------
+
+/** One connection sending requests one at a time
+
+    In a closed loop each request is sent as soon
+    as the previous response arrives, and latency
+    is measured from when it was sent.
+
+    In an open loop requests are due at a constant
+    interval. A request sent late because the last
+    response was slow is still timed from when it
+    was due, so a stalled server is charged for the
+    requests it kept waiting. This corrects for
+    coordinated omission.
+*/
+class client
+{
+    stats& r_;
+    tcp::endpoint ep_;
+    http_proto::request const& req_;
+    clock_type::time_point end_;
+    clock_type::duration interval_;
+    tcp::socket sock_;
+    asio::steady_timer timer_;
+    http_proto::serializer sr_;
+    http_proto::response_parser pr_;
+    clock_type::time_point due_;
+    bool is_stopped_ = false;
+
+public:
+    client(
+        asio::io_context& ioc,
+        http_proto::context& ctx,
+        stats& r,
+        tcp::endpoint const& ep,
+        http_proto::request const& req,
+        clock_type::time_point end,
+        clock_type::duration interval)
+        : r_(r)
+        , ep_(ep)
+        , req_(req)
+        , end_(end)
+        , interval_(interval)
+        , sock_(ioc)
+        , timer_(ioc)
+        , sr_(ctx)
+        , pr_(ctx)
+    {
+    }
+
+    void
+    run(clock_type::time_point first)
+    {
+        due_ = first;
+        do_connect();
+    }
+
+    // Abandon any request in flight
+    void
+    stop()
+    {
+        is_stopped_ = true;
+        boost::system::error_code ec;
+        timer_.cancel();
+        sock_.close(ec);
+    }
+
+private:
+    bool
+    is_open_loop() const noexcept
+    {
+        return interval_ != clock_type::duration::zero();
+    }
+
+    void
+    do_connect()
+    {
+        boost::system::error_code ec;
+        sock_.close(ec);
+        if(clock_type::now() >= end_)
+            return;
+        pr_.reset();
+        sock_.async_connect(ep_, std::bind(
+            &client::on_connect, this, _1));
+    }
+
+    void
+    on_connect(boost::system::error_code ec)
+    {
+        if(is_stopped_)
+            return;
+        if(ec.failed())
+        {
+            ++r_.connect_errors;
+            return do_connect();
+        }
+        sock_.set_option(tcp::no_delay(true), ec);
+        do_wait();
+    }
+
+    // Wait until the next request is due
+    void
+    do_wait()
+    {
+        if(clock_type::now() >= end_)
+            return;
+        if( ! is_open_loop() ||
+            due_ <= clock_type::now())
+            return do_write();
+        timer_.expires_at(due_);
+        timer_.async_wait(std::bind(
+            &client::on_timer, this, _1));
+    }
+
+    void
+    on_timer(boost::system::error_code ec)
+    {
+        if(is_stopped_ || ec.failed())
+            return;
+        do_write();
+    }
+
+    void
+    do_write()
+    {
+        if(! is_open_loop())
+            due_ = clock_type::now();
+        sr_.start(req_);
+        http_io::async_write(sock_, sr_, std::bind(
+            &client::on_write, this, _1, _2));
+    }
+
+    void
+    on_write(
+        boost::system::error_code ec,
+        std::size_t bytes_transferred)
+    {
+        if(is_stopped_)
+            return;
+        r_.bytes_out += bytes_transferred;
+        if(ec.failed())
+        {
+            ++r_.write_errors;
+            return do_connect();
+        }
+        pr_.start();
+        http_io::async_read_header(sock_, pr_, std::bind(
+            &client::on_read_header, this, _1, _2));
+    }
+
+    void
+    on_read_header(
+        boost::system::error_code ec,
+        std::size_t bytes_transferred)
+    {
+        if(is_stopped_)
+            return;
+        r_.bytes_in += bytes_transferred;
+        if(ec.failed())
+        {
+            ++r_.read_errors;
+            return do_connect();
+        }
+        pr_.set_body_limit(~std::uint64_t(0));
+        pr_.set_body<null_sink>();
+        http_io::async_read(sock_, pr_, std::bind(
+            &client::on_read, this, _1, _2));
+    }
+
+    void
+    on_read(
+        boost::system::error_code ec,
+        std::size_t bytes_transferred)
+    {
+        if(is_stopped_)
+            return;
+        r_.bytes_in += bytes_transferred;
+        if(ec.failed())
+        {
+            ++r_.read_errors;
+            return do_connect();
+        }
+
+        auto const now = clock_type::now();
+        r_.latency.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<
+                std::chrono::nanoseconds>(
+                    now - due_).count()));
+        ++r_.requests;
+        if(pr_.get().status_int() / 100 != 2)
+            ++r_.non_2xx;
+
+        if(is_open_loop())
+            due_ += interval_;
+        if(! pr_.get().keep_alive())
+            return do_connect();
+        do_wait();
+    }
+};
+
+//------------------------------------------------
+
+// The connections of one thread
+class runner
+{
+    asio::io_context ioc_;
+    stats r_;
+    std::vector<std::unique_ptr<client>> clients_;
+    asio::steady_timer timer_;
+    std::thread thread_;
+
+public:
+    runner(
+        http_proto::context& ctx,
+        options const& opt,
+        tcp::endpoint const& ep,
+        http_proto::request const& req,
+        std::size_t connections,
+        clock_type::time_point start)
+        : ioc_(1)
+        , timer_(ioc_)
+    {
+        auto const end = start + opt.duration;
+        clock_type::duration interval{};
+        if(opt.rate > 0)
+            interval = std::chrono::duration_cast<
+                clock_type::duration>(std::chrono::duration<
+                    double>(opt.connections / opt.rate));
+
+        for(std::size_t i = 0; i < connections; ++i)
+            clients_.emplace_back(new client(
+                ioc_, ctx, r_, ep, req, end, interval));
+
+        // Spread the first requests across one
+        // interval so they do not arrive together
+        for(std::size_t i = 0; i < clients_.size(); ++i)
+            clients_[i]->run(start + interval *
+                static_cast<clock_type::rep>(i) /
+                static_cast<clock_type::rep>(clients_.size()));
+
+        timer_.expires_at(end);
+        timer_.async_wait(std::bind(
+            &runner::on_end, this, _1));
+    }
+
+    void
+    start()
+    {
+        thread_ = std::thread([this]{ ioc_.run(); });
+    }
+
+    stats const&
+    join()
+    {
+        thread_.join();
+        return r_;
+    }
+
+private:
+    void
+    on_end(boost::system::error_code)
+    {
+        for(auto& c : clients_)
+            c->stop();
+    }
+};
+
+//------------------------------------------------
+
+void
+usage()
+{
+    std::cerr <<
+        "Usage: http_io_bench [options] <host> <port> [<target>]\n"
+        "  -c <n>     Connections to keep open (default 64)\n"
+        "  -t <n>     Threads to use (default 1)\n"
+        "  -d <secs>  Duration of the test (default 10)\n"
+        "  -r <n>     Total requests per second. Latency is measured from\n"
+        "             when each request was due, correcting for coordinated\n"
+        "             omission. Without this, each connection sends its next\n"
+        "             request as soon as a response arrives.\n"
+        "  For example:\n"
+        "    http_io_bench -c 100 -t 4 -d 30 -r 50000 127.0.0.1 8080 /index.html\n";
+}
+
+bool
+parse_args(
+    int argc,
+    char* argv[],
+    options& opt)
+{
+    std::vector<char const*> args;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(argv[i][0] != '-' || argv[i][1] == 0)
+        {
+            args.push_back(argv[i]);
+            continue;
+        }
+        if(argv[i][2] != 0 || i + 1 >= argc)
+            return false;
+        auto const v = argv[++i];
+        switch(argv[i - 1][1])
+        {
+        case 'c': opt.connections = std::strtoul(v, nullptr, 10); break;
+        case 't': opt.threads = std::strtoul(v, nullptr, 10); break;
+        case 'd': opt.duration = std::chrono::seconds(std::atoi(v)); break;
+        case 'r': opt.rate = std::atof(v); break;
+        default:
+            return false;
+        }
+    }
+    if(args.size() < 2 || args.size() > 3)
+        return false;
+    opt.host = args[0];
+    opt.port = args[1];
+    if(args.size() > 2)
+        opt.target = args[2];
+    return
+        opt.threads > 0 &&
+        opt.connections >= opt.threads &&
+        opt.duration.count() > 0 &&
+        opt.rate >= 0;
+}
+
+void
+report(
+    options const& opt,
+    stats const& r,
+    clock_type::duration elapsed)
+{
+    auto const secs = std::chrono::duration<
+        double>(elapsed).count();
+    auto const us = [](std::uint64_t ns)
+    {
+        return static_cast<double>(ns) / 1000;
+    };
+
+    std::printf("Latency (us)\n");
+    std::printf("  %9s  %10.1f\n", "min", us(r.latency.min()));
+    std::printf("  %9s  %10.1f\n", "mean", r.latency.mean() / 1000);
+    static double const pcts[] = {
+        50, 75, 90, 99, 99.9, 99.99, 99.999 };
+    for(auto p : pcts)
+    {
+        char name[16];
+        std::snprintf(name, sizeof(name), "%g%%", p);
+        std::printf("  %9s  %10.1f\n", name,
+            us(r.latency.percentile(p)));
+    }
+    std::printf("  %9s  %10.1f\n", "max", us(r.latency.max()));
+
+    std::printf("\n%llu requests in %.2fs, %.2f MB read\n",
+        static_cast<unsigned long long>(r.requests), secs,
+        static_cast<double>(r.bytes_in) / (1024 * 1024));
+    if(opt.rate > 0)
+        std::printf("Target:    %.2f requests/sec\n", opt.rate);
+    std::printf("Requests:  %.2f requests/sec\n",
+        static_cast<double>(r.requests) / secs);
+    std::printf("Transfer:  %.2f MB/sec\n",
+        static_cast<double>(r.bytes_in) / (1024 * 1024) / secs);
+    if( r.non_2xx || r.connect_errors ||
+        r.read_errors || r.write_errors)
+        std::printf(
+            "Errors:    connect %llu, read %llu, write %llu, non-2xx %llu\n",
+            static_cast<unsigned long long>(r.connect_errors),
+            static_cast<unsigned long long>(r.read_errors),
+            static_cast<unsigned long long>(r.write_errors),
+            static_cast<unsigned long long>(r.non_2xx));
+}
+
+int
+main(int argc, char* argv[])
+{
+    try
+    {
+        options opt;
+        if(! parse_args(argc, argv, opt))
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+
+        tcp::endpoint ep;
+        {
+            asio::io_context ioc;
+            tcp::resolver resolver(ioc);
+            ep = *resolver.resolve(opt.host, opt.port).begin();
+        }
+
+        http_proto::context ctx;
+        {
+            http_proto::response_parser::config cfg;
+            http_proto::install_parser_service(ctx, cfg);
+        }
+
+        http_proto::request req;
+        req.set_start_line(
+            http_proto::method::get,
+            opt.target,
+            http_proto::version::http_1_1);
+        req.set(http_proto::field::host, opt.host);
+        req.set(http_proto::field::user_agent, "Boost.Http.IO bench");
+
+        std::cout <<
+            "Running " << opt.duration.count() << "s test @ " <<
+            opt.host << ":" << opt.port << opt.target << "\n"
+            "  " << opt.threads << " threads and " <<
+            opt.connections << " connections, " <<
+            (opt.rate > 0 ? "open loop" : "closed loop") <<
+            "\n\n" << std::flush;
+
+        // Each thread runs its own io_context
+        // and shares nothing until the end
+        auto const start = clock_type::now();
+        std::vector<std::unique_ptr<runner>> runners;
+        for(std::size_t i = 0; i < opt.threads; ++i)
+        {
+            auto const n = opt.connections / opt.threads +
+                (i < opt.connections % opt.threads ? 1 : 0);
+            runners.emplace_back(new runner(
+                ctx, opt, ep, req, n, start));
+        }
+        for(auto& r : runners)
+            r->start();
+
+        stats total;
+        for(auto& r : runners)
+            total.merge(r->join());
+
+        report(opt, total, clock_type::now() - start);
+        return EXIT_SUCCESS;
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -47,14 +47,8 @@ any_ostream::any_ostream(fs::path path, bool append)
     }
     else
     {
-        auto& f = stream_.emplace<std::ofstream>();
-        f.exceptions(std::ofstream::badbit);
-        if(append)
-            f.open(path, std::ofstream::app);
-        else
-            f.open(path);
-        if(!f.is_open())
-            throw std::runtime_error{ "Couldn't open file" };
+        auto& f = stream_.emplace<async_ofstream>(path, append);
+        f.exceptions(std::ostream::badbit);
     }
 }
 
@@ -64,17 +58,24 @@ any_ostream::is_tty() const noexcept
     return is_tty_;
 }
 
+void
+any_ostream::reserve(std::uint64_t n) noexcept
+{
+    if(auto* s = std::get_if<async_ofstream>(&stream_))
+        s->reserve(n);
+}
+
 void
 any_ostream::close()
 {
-    if(auto* s = std::get_if<std::ofstream>(&stream_))
+    if(auto* s = std::get_if<async_ofstream>(&stream_))
         s->close();
 }
 
 any_ostream::
 operator std::ostream&()
 {
-    if(auto* s = std::get_if<std::ofstream>(&stream_))
+    if(auto* s = std::get_if<async_ofstream>(&stream_))
         return *s;
     return *std::get<std::ostream*>(stream_);
 }
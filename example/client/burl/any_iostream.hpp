@@ -10,8 +10,11 @@
 #ifndef BURL_ANY_IOSTREAM_HPP
 #define BURL_ANY_IOSTREAM_HPP
 
+#include "async_ofstream.hpp"
+
 #include <boost/core/detail/string_view.hpp>
 
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -22,7 +25,7 @@ namespace core = boost::core;
 
 class any_ostream
 {
-    std::variant<std::ofstream, std::ostream*> stream_;
+    std::variant<std::ostream*, async_ofstream> stream_;
     bool is_tty_ = false;
 
 public:
@@ -33,6 +36,10 @@ public:
     bool
     is_tty() const noexcept;
 
+    /// Reserve disk space for `n` more bytes of a file
+    void
+    reserve(std::uint64_t n) noexcept;
+
     void
     close();
 
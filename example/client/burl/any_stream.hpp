@@ -10,8 +10,13 @@
 #ifndef BURL_ANY_STREAM_HPP
 #define BURL_ANY_STREAM_HPP
 
+#include "rate_limiter.hpp"
+
 #include <boost/asio/any_completion_handler.hpp>
 #include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/bind_allocator.hpp>
+#include <boost/asio/buffer.hpp>
 #include <boost/asio/compose.hpp>
 #include <boost/asio/coroutine.hpp>
 #include <boost/asio/immediate.hpp>
@@ -20,6 +25,10 @@
 #include <boost/http_proto/parser.hpp>
 #include <boost/http_proto/serializer.hpp>
 
+#include <cstddef>
+#include <memory>
+#include <new>
+
 namespace asio       = boost::asio;
 namespace buffers    = boost::buffers;
 namespace http_proto = boost::http_proto;
@@ -71,6 +80,26 @@ public:
                 stream_.async_read_some(buffers, std::move(handler));
             }
 
+            virtual bool
+            is_stale() override
+            {
+                auto& socket = stream_.lowest_layer();
+                if(!socket.is_open())
+                    return true;
+
+                // An idle connection has nothing to read, so
+                // anything readable is either EOF or data that
+                // belongs to no request. Both make it unusable.
+                auto ec = error_code{};
+                auto c  = char{};
+                socket.non_blocking(true, ec);
+                socket.receive(
+                    asio::buffer(&c, 1), socket.message_peek, ec);
+                auto ec2 = error_code{};
+                socket.non_blocking(false, ec2);
+                return ec != asio::error::would_block;
+            }
+
             virtual void
             async_shutdown(
                 asio::any_completion_handler<void(error_code)> handler) override
@@ -108,20 +137,34 @@ public:
         return stream_->get_executor();
     }
 
+    /** Return true if an idle connection can't be reused
+
+        This is the case once the peer has closed it.
+    */
+    bool
+    is_stale()
+    {
+        return stream_->is_stale();
+    }
+
+    /** Draw bytes read from a shared limiter
+
+        A null limiter removes the limit.
+    */
     void
-    read_limit(std::size_t bytes_per_second) noexcept
+    read_limit(std::shared_ptr<rate_limiter> limiter) noexcept
     {
-        rd_limit_ = bytes_per_second;
-        if(rd_remain_ > bytes_per_second)
-            rd_remain_ = bytes_per_second;
+        rd_limiter_ = std::move(limiter);
     }
 
+    /** Draw bytes written from a shared limiter
+
+        A null limiter removes the limit.
+    */
     void
-    write_limit(std::size_t bytes_per_second) noexcept
+    write_limit(std::shared_ptr<rate_limiter> limiter) noexcept
     {
-        wr_limit_ = bytes_per_second;
-        if(wr_remain_ > bytes_per_second)
-            wr_remain_ = bytes_per_second;
+        wr_limiter_ = std::move(limiter);
     }
 
     template<
@@ -132,34 +175,66 @@ public:
         const const_buffers_type& buffers,
         CompletionToken&& token = CompletionToken{})
     {
-        return asio::
-            async_compose<CompletionToken, void(error_code, std::size_t)>(
-                [this, c = asio::coroutine{}, buffers](
-                    auto&& self, error_code ec = {}, std::size_t n = {}) mutable
-                {
-                    BOOST_ASIO_CORO_REENTER(c)
+        return asio::async_initiate<
+            CompletionToken,
+            void(error_code, std::size_t)>(
+            [this](auto handler, const const_buffers_type& buffers)
+            {
+                auto alloc = slot_allocator<void>{ &stream_->wr_slot };
+                auto size  = buffers::buffer_size(buffers);
+
+                // Unlimited streams go straight to the stream
+                if(!wr_limiter_)
+                    return stream_->async_write_some(
+                        buffers::prefix(buffers, size),
+                        asio::bind_allocator(alloc, std::move(handler)));
+
+                asio::async_compose<
+                    decltype(handler),
+                    void(error_code, std::size_t)>(
+                    [this, c = asio::coroutine{}, buffers, size, alloc](
+                        auto&& self,
+                        error_code ec = {},
+                        std::size_t n = {}) mutable
                     {
-                        self.reset_cancellation_state(
-                            asio::enable_total_cancellation{});
-                        if(wr_remain_ == 0)
+                        BOOST_ASIO_CORO_REENTER(c)
                         {
-                            wr_timer.expires_after(std::chrono::seconds{ 1 });
+                            self.reset_cancellation_state(
+                                asio::enable_total_cancellation{});
+                            wr_wait_.want  = size;
+                            wr_wait_.timer = &wr_timer;
+                            if(!wr_limiter_->acquire(wr_wait_))
+                            {
+                                wr_timer.expires_at(
+                                    asio::steady_timer::time_point::max());
+                                BOOST_ASIO_CORO_YIELD
+                                wr_timer.async_wait(asio::bind_allocator(
+                                    alloc, std::move(self)));
+
+                                // The limiter cancels the timer to grant,
+                                // a grant may also have come in after the
+                                // wait was cancelled
+                                if(wr_wait_.granted == 0 || !!self.cancelled())
+                                {
+                                    wr_limiter_->cancel(wr_wait_);
+                                    wr_limiter_->refund(wr_wait_.granted);
+                                    return self.complete(
+                                        asio::error::operation_aborted, 0);
+                                }
+                            }
                             BOOST_ASIO_CORO_YIELD
-                            wr_timer.async_wait(std::move(self));
-                            if(ec)
-                                return self.complete(ec, n);
-                            wr_remain_ = wr_limit_;
+                            stream_->async_write_some(
+                                buffers::prefix(buffers, wr_wait_.granted),
+                                asio::bind_allocator(alloc, std::move(self)));
+                            wr_limiter_->refund(wr_wait_.granted - n);
+                            self.complete(ec, n);
                         }
-                        BOOST_ASIO_CORO_YIELD
-                        stream_->async_write_some(
-                            buffers::prefix(buffers, wr_remain_),
-                            std::move(self));
-                        wr_remain_ -= n;
-                        self.complete(ec, n);
-                    }
-                },
-                token,
-                get_executor());
+                    },
+                    handler,
+                    get_executor());
+            },
+            token,
+            buffers);
     }
 
     template<
@@ -170,34 +245,66 @@ public:
         const mutable_buffers_type& buffers,
         CompletionToken&& token = CompletionToken{})
     {
-        return asio::
-            async_compose<CompletionToken, void(error_code, std::size_t)>(
-                [this, c = asio::coroutine{}, buffers](
-                    auto&& self, error_code ec = {}, std::size_t n = {}) mutable
-                {
-                    BOOST_ASIO_CORO_REENTER(c)
+        return asio::async_initiate<
+            CompletionToken,
+            void(error_code, std::size_t)>(
+            [this](auto handler, const mutable_buffers_type& buffers)
+            {
+                auto alloc = slot_allocator<void>{ &stream_->rd_slot };
+                auto size  = buffers::buffer_size(buffers);
+
+                // Unlimited streams go straight to the stream
+                if(!rd_limiter_)
+                    return stream_->async_read_some(
+                        buffers::prefix(buffers, size),
+                        asio::bind_allocator(alloc, std::move(handler)));
+
+                asio::async_compose<
+                    decltype(handler),
+                    void(error_code, std::size_t)>(
+                    [this, c = asio::coroutine{}, buffers, size, alloc](
+                        auto&& self,
+                        error_code ec = {},
+                        std::size_t n = {}) mutable
                     {
-                        self.reset_cancellation_state(
-                            asio::enable_total_cancellation{});
-                        if(rd_remain_ == 0)
+                        BOOST_ASIO_CORO_REENTER(c)
                         {
-                            rd_timer.expires_after(std::chrono::seconds{ 1 });
+                            self.reset_cancellation_state(
+                                asio::enable_total_cancellation{});
+                            rd_wait_.want  = size;
+                            rd_wait_.timer = &rd_timer;
+                            if(!rd_limiter_->acquire(rd_wait_))
+                            {
+                                rd_timer.expires_at(
+                                    asio::steady_timer::time_point::max());
+                                BOOST_ASIO_CORO_YIELD
+                                rd_timer.async_wait(asio::bind_allocator(
+                                    alloc, std::move(self)));
+
+                                // The limiter cancels the timer to grant,
+                                // a grant may also have come in after the
+                                // wait was cancelled
+                                if(rd_wait_.granted == 0 || !!self.cancelled())
+                                {
+                                    rd_limiter_->cancel(rd_wait_);
+                                    rd_limiter_->refund(rd_wait_.granted);
+                                    return self.complete(
+                                        asio::error::operation_aborted, 0);
+                                }
+                            }
                             BOOST_ASIO_CORO_YIELD
-                            rd_timer.async_wait(std::move(self));
-                            if(ec)
-                                return self.complete(ec, n);
-                            rd_remain_ = rd_limit_;
+                            stream_->async_read_some(
+                                buffers::prefix(buffers, rd_wait_.granted),
+                                asio::bind_allocator(alloc, std::move(self)));
+                            rd_limiter_->refund(rd_wait_.granted - n);
+                            self.complete(ec, n);
                         }
-                        BOOST_ASIO_CORO_YIELD
-                        stream_->async_read_some(
-                            buffers::prefix(buffers, rd_remain_),
-                            std::move(self));
-                        rd_remain_ -= n;
-                        self.complete(ec, n);
-                    }
-                },
-                token,
-                get_executor());
+                    },
+                    handler,
+                    get_executor());
+            },
+            token,
+            buffers);
     }
 
     template<
@@ -218,8 +325,101 @@ public:
     }
 
 private:
+    /** Memory reused by the handlers of one direction
+
+        Only one operation per direction is outstanding
+        at a time, so the blocks serve every operation in
+        turn. Larger or additional allocations fall back
+        to the heap.
+    */
+    class handler_slot
+    {
+        static constexpr std::size_t block_size  = 1024;
+        static constexpr std::size_t block_count = 2;
+
+        alignas(std::max_align_t) unsigned char
+            storage_[block_count][block_size];
+        bool in_use_[block_count] = {};
+
+    public:
+        void*
+        allocate(std::size_t n)
+        {
+            for(auto i = std::size_t{}; i != block_count; ++i)
+            {
+                if(!in_use_[i] && n <= block_size)
+                {
+                    in_use_[i] = true;
+                    return storage_[i];
+                }
+            }
+            return ::operator new(n);
+        }
+
+        void
+        deallocate(void* p) noexcept
+        {
+            for(auto i = std::size_t{}; i != block_count; ++i)
+            {
+                if(p == storage_[i])
+                {
+                    in_use_[i] = false;
+                    return;
+                }
+            }
+            ::operator delete(p);
+        }
+    };
+
+    template<typename T>
+    class slot_allocator
+    {
+        template<typename>
+        friend class slot_allocator;
+
+        handler_slot* slot_;
+
+    public:
+        using value_type = T;
+
+        explicit slot_allocator(handler_slot* slot) noexcept
+            : slot_{ slot }
+        {
+        }
+
+        template<typename U>
+        slot_allocator(const slot_allocator<U>& other) noexcept
+            : slot_{ other.slot_ }
+        {
+        }
+
+        T*
+        allocate(std::size_t n)
+        {
+            return static_cast<T*>(slot_->allocate(sizeof(T) * n));
+        }
+
+        void
+        deallocate(T* p, std::size_t) noexcept
+        {
+            slot_->deallocate(p);
+        }
+
+        template<typename U>
+        bool
+        operator==(const slot_allocator<U>& other) const noexcept
+        {
+            return slot_ == other.slot_;
+        }
+    };
+
     struct base
     {
+        // owned by the implementation so that their
+        // address survives moving the any_stream
+        handler_slot rd_slot;
+        handler_slot wr_slot;
+
         virtual asio::any_io_executor
         get_executor() = 0;
 
@@ -233,6 +433,9 @@ private:
             const buffers::mutable_buffer_subspan&,
             asio::any_completion_handler<void(error_code, std::size_t)>) = 0;
 
+        virtual bool
+        is_stale() = 0;
+
         virtual void async_shutdown(
             asio::any_completion_handler<void(error_code)>) = 0;
 
@@ -242,10 +445,10 @@ private:
     std::unique_ptr<base> stream_;
     asio::steady_timer rd_timer;
     asio::steady_timer wr_timer;
-    std::size_t rd_remain_ = (std::numeric_limits<std::size_t>::max)();
-    std::size_t wr_remain_ = (std::numeric_limits<std::size_t>::max)();
-    std::size_t rd_limit_  = (std::numeric_limits<std::size_t>::max)();
-    std::size_t wr_limit_  = (std::numeric_limits<std::size_t>::max)();
+    std::shared_ptr<rate_limiter> rd_limiter_;
+    std::shared_ptr<rate_limiter> wr_limiter_;
+    rate_limiter::waiter rd_wait_;
+    rate_limiter::waiter wr_wait_;
 };
 
 #endif
@@ -0,0 +1,309 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "async_ofstream.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+constexpr auto block_alignment = std::align_val_t{ 4096 };
+} // namespace
+
+void
+async_filebuf::block_deleter::operator()(char* p) const noexcept
+{
+    ::operator delete(p, block_alignment);
+}
+
+#ifdef _WIN32
+
+async_filebuf::async_filebuf(const fs::path& path, bool append)
+{
+    auto h = ::CreateFileW(
+        path.c_str(),
+        append ? FILE_APPEND_DATA : GENERIC_WRITE,
+        FILE_SHARE_READ,
+        nullptr,
+        append ? OPEN_ALWAYS : CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if(h == INVALID_HANDLE_VALUE)
+        throw_last_error("CreateFileW");
+    handle_ = h;
+    thread_ = std::thread{ [this] { run(); } };
+}
+
+void
+async_filebuf::reserve(std::uint64_t n) noexcept
+{
+    auto size = LARGE_INTEGER{};
+    if(!::GetFileSizeEx(static_cast<HANDLE>(handle_), &size))
+        return;
+
+    auto info                    = FILE_ALLOCATION_INFO{};
+    info.AllocationSize.QuadPart = size.QuadPart + static_cast<LONGLONG>(n);
+    ::SetFileInformationByHandle(
+        static_cast<HANDLE>(handle_), FileAllocationInfo, &info, sizeof(info));
+}
+
+error_code
+async_filebuf::write(const char* p, std::size_t n) noexcept
+{
+    while(n != 0)
+    {
+        auto written = DWORD{};
+        if(!::WriteFile(
+               static_cast<HANDLE>(handle_),
+               p,
+               static_cast<DWORD>(n),
+               &written,
+               nullptr))
+            return last_system_error();
+        p += written;
+        n -= written;
+    }
+    return {};
+}
+
+#else
+
+async_filebuf::async_filebuf(const fs::path& path, bool append)
+{
+    auto flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    fd_        = ::open(path.c_str(), flags, 0666);
+    if(fd_ == -1)
+        throw_last_error("open");
+    thread_ = std::thread{ [this] { run(); } };
+}
+
+void
+async_filebuf::reserve(std::uint64_t n) noexcept
+{
+#ifdef __linux__
+    struct stat st;
+    if(::fstat(fd_, &st) == 0)
+        ::fallocate(
+            fd_, FALLOC_FL_KEEP_SIZE, st.st_size, static_cast<off_t>(n));
+#else
+    (void)n;
+#endif
+}
+
+error_code
+async_filebuf::write(const char* p, std::size_t n) noexcept
+{
+    while(n != 0)
+    {
+        auto written = ::write(fd_, p, n);
+        if(written == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            return last_system_error();
+        }
+        p += written;
+        n -= static_cast<std::size_t>(written);
+    }
+    return {};
+}
+
+#endif
+
+async_filebuf::~async_filebuf()
+{
+    close();
+}
+
+error_code
+async_filebuf::close() noexcept
+{
+    if(!thread_.joinable())
+        return ec_;
+
+    {
+        auto lock = std::unique_lock{ mutex_ };
+        hand_off(lock);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+#ifdef _WIN32
+    ::CloseHandle(static_cast<HANDLE>(handle_));
+#else
+    if(::close(fd_) != 0 && !ec_)
+        ec_ = last_system_error();
+#endif
+    return ec_;
+}
+
+async_filebuf::int_type
+async_filebuf::overflow(int_type ch)
+{
+    if(!next_block())
+        return traits_type::eof();
+
+    if(!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize
+async_filebuf::xsputn(const char* s, std::streamsize n)
+{
+    auto left = n;
+    while(left != 0)
+    {
+        if(pptr() == epptr() && !next_block())
+            break;
+
+        auto chunk = std::min<std::streamsize>(left, epptr() - pptr());
+        std::memcpy(pptr(), s, static_cast<std::size_t>(chunk));
+        pbump(static_cast<int>(chunk));
+        s    += chunk;
+        left -= chunk;
+    }
+    return n - left;
+}
+
+int
+async_filebuf::sync()
+{
+    auto lock = std::unique_lock{ mutex_ };
+    return hand_off(lock) ? 0 : -1;
+}
+
+bool
+async_filebuf::hand_off(std::unique_lock<std::mutex>&)
+{
+    if(current_ && pptr() != pbase())
+    {
+        auto size = static_cast<std::size_t>(pptr() - pbase());
+        queue_.push_back({ std::move(current_), size });
+        setp(nullptr, nullptr);
+        cv_.notify_all();
+    }
+    return !ec_;
+}
+
+bool
+async_filebuf::next_block()
+{
+    auto lock = std::unique_lock{ mutex_ };
+    if(!hand_off(lock) || stop_)
+        return false;
+
+    if(!current_)
+    {
+        cv_.wait(
+            lock,
+            [&] { return ec_ || !free_.empty() || blocks_ != max_blocks; });
+        if(ec_)
+            return false;
+
+        if(!free_.empty())
+        {
+            current_ = std::move(free_.back());
+            free_.pop_back();
+        }
+        else
+        {
+            current_.reset(static_cast<char*>(
+                ::operator new(block_size, block_alignment)));
+            ++blocks_;
+        }
+    }
+
+    setp(current_.get(), current_.get() + block_size);
+    return true;
+}
+
+void
+async_filebuf::run()
+{
+    auto lock = std::unique_lock{ mutex_ };
+    for(;;)
+    {
+        cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+        if(queue_.empty())
+            return;
+
+        auto p = std::move(queue_.front());
+        queue_.pop_front();
+
+        // After a failure the rest is only recycled
+        if(!ec_)
+        {
+            lock.unlock();
+            auto ec = write(p.data.get(), p.size);
+            lock.lock();
+            if(ec)
+                ec_ = ec;
+        }
+
+        free_.push_back(std::move(p.data));
+        cv_.notify_all();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+async_ofstream::async_ofstream(const fs::path& path, bool append)
+    : std::ostream{ nullptr }
+    , buf_{ std::make_unique<async_filebuf>(path, append) }
+{
+    rdbuf(buf_.get());
+}
+
+async_ofstream::async_ofstream(async_ofstream&& other) noexcept
+    : std::ostream{ std::move(other) }
+    , buf_{ std::move(other.buf_) }
+{
+    set_rdbuf(buf_.get());
+}
+
+async_ofstream&
+async_ofstream::operator=(async_ofstream&& other) noexcept
+{
+    std::ostream::operator=(std::move(other));
+    buf_ = std::move(other.buf_);
+    set_rdbuf(buf_.get());
+    other.set_rdbuf(nullptr);
+    return *this;
+}
+
+void
+async_ofstream::reserve(std::uint64_t n) noexcept
+{
+    if(buf_)
+        buf_->reserve(n);
+}
+
+void
+async_ofstream::close()
+{
+    if(buf_ && buf_->close())
+        setstate(std::ios_base::failbit);
+}
@@ -0,0 +1,157 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_ASYNC_OFSTREAM_HPP
+#define BURL_ASYNC_OFSTREAM_HPP
+
+#include <boost/system/error_code.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace fs     = std::filesystem;
+using error_code = boost::system::error_code;
+
+/** A file stream buffer written by a thread of its own
+
+    Output is gathered into large page-aligned blocks.
+    Full blocks go to a writer thread while the caller
+    fills the next one, so a slow disk doesn't hold up
+    the event loop. Only a few blocks can be in flight,
+    and the caller waits only when all of them are.
+*/
+class async_filebuf : public std::streambuf
+{
+    static constexpr std::size_t block_size = 256 * 1024;
+    static constexpr std::size_t max_blocks = 8;
+
+    struct block_deleter
+    {
+        void
+        operator()(char* p) const noexcept;
+    };
+
+    using block = std::unique_ptr<char[], block_deleter>;
+
+    struct pending
+    {
+        block data;
+        std::size_t size;
+    };
+
+#ifdef _WIN32
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<pending> queue_;
+    std::vector<block> free_;
+    std::size_t blocks_ = 0;
+    error_code ec_;
+    bool stop_ = false;
+    block current_;
+    std::thread thread_;
+
+public:
+    /** Create, truncate or append to a file
+
+        @throws boost::system::system_error
+    */
+    async_filebuf(const fs::path& path, bool append);
+
+    async_filebuf(const async_filebuf&) = delete;
+
+    async_filebuf&
+    operator=(const async_filebuf&) = delete;
+
+    /// Write out what is left, ignoring errors
+    ~async_filebuf() override;
+
+    /** Reserve disk space for more bytes
+
+        This is only a hint, it doesn't change the size
+        of the file and does nothing on systems that
+        can't allocate space without doing so.
+    */
+    void
+    reserve(std::uint64_t n) noexcept;
+
+    /// Write out what is left and close the file
+    error_code
+    close() noexcept;
+
+protected:
+    int_type
+    overflow(int_type ch) override;
+
+    std::streamsize
+    xsputn(const char* s, std::streamsize n) override;
+
+    // Hands the filled part of the block to the writer
+    // without waiting for it to be written.
+    int
+    sync() override;
+
+private:
+    bool
+    hand_off(std::unique_lock<std::mutex>& lock);
+
+    bool
+    next_block();
+
+    void
+    run();
+
+    error_code
+    write(const char* p, std::size_t n) noexcept;
+};
+
+/** An output file stream backed by @ref async_filebuf
+
+    Write errors show up when they are found by the
+    writer thread, or at the latest by @ref close.
+*/
+class async_ofstream : public std::ostream
+{
+    std::unique_ptr<async_filebuf> buf_;
+
+public:
+    /** Constructor
+
+        @throws boost::system::system_error
+    */
+    async_ofstream(const fs::path& path, bool append);
+
+    async_ofstream(async_ofstream&& other) noexcept;
+
+    async_ofstream&
+    operator=(async_ofstream&& other) noexcept;
+
+    void
+    reserve(std::uint64_t n) noexcept;
+
+    /** Write out what is left and close the file
+
+        Sets failbit if anything couldn't be written.
+    */
+    void
+    close();
+};
+
+#endif
@@ -9,8 +9,10 @@
 
 #include "connect.hpp"
 #include "base64.hpp"
+#include "connection_pool.hpp"
+#include "happy_eyeballs.hpp"
+#include "tls_session_cache.hpp"
 
-#include <boost/asio/connect.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/local/stream_protocol.hpp>
 #include <boost/asio/read.hpp>
@@ -46,17 +48,17 @@ effective_port(const urls::url_view& url)
 
 asio::awaitable<void>
 connect_socks5_proxy(
+    dns_cache& dns,
     asio::ip::tcp::socket& stream,
     const urls::url_view& url,
     const urls::url_view& proxy)
 {
-    auto executor = co_await asio::this_coro::executor;
-    auto resolver = asio::ip::tcp::resolver{ executor };
-    auto rresults =
-        co_await resolver.async_resolve(proxy.host(), effective_port(proxy));
+    auto rresults = co_await dns.async_resolve(
+        proxy.host(), std::string{ effective_port(proxy) });
 
     // Connect to the proxy server
-    co_await asio::async_connect(stream, rresults);
+    co_await async_connect_racing(
+        stream, { rresults.begin(), rresults.end() });
 
     // Greeting request
     if(proxy.has_userinfo())
@@ -153,17 +155,17 @@ asio::awaitable<void>
 connect_http_proxy(
     const operation_config& oc,
     http_proto::context& proto_ctx,
+    dns_cache& dns,
     asio::ip::tcp::socket& stream,
     const urls::url_view& url,
     const urls::url_view& proxy)
 {
-    auto executor = co_await asio::this_coro::executor;
-    auto resolver = asio::ip::tcp::resolver{ executor };
-    auto rresults =
-        co_await resolver.async_resolve(proxy.host(), effective_port(proxy));
+    auto rresults = co_await dns.async_resolve(
+        proxy.host(), std::string{ effective_port(proxy) });
 
     // Connect to the proxy server
-    co_await asio::async_connect(stream, rresults);
+    co_await async_connect_racing(
+        stream, { rresults.begin(), rresults.end() });
 
     using field    = http_proto::field;
     auto request   = http_proto::request{};
@@ -205,7 +207,11 @@ connect_http_proxy(
 
 template<typename Socket>
 asio::awaitable<ssl::stream<Socket>>
-perform_tls_handshake(ssl::context& ssl_ctx, Socket socket, std::string host)
+perform_tls_handshake(
+    ssl::context& ssl_ctx,
+    Socket socket,
+    std::string host,
+    const std::string& session_key)
 {
     auto ssl_stream = ssl::stream<Socket>{ std::move(socket), ssl_ctx };
 
@@ -213,6 +219,8 @@ perform_tls_handshake(ssl::context& ssl_ctx, Socket socket, std::string host)
         throw system_error{ static_cast<int>(::ERR_get_error()),
                             asio::error::get_ssl_category() };
 
+    tls_session_cache::resume(ssl_stream.native_handle(), session_key);
+
     co_await ssl_stream.async_handshake(ssl::stream_base::client);
     co_return ssl_stream;
 }
@@ -223,11 +231,13 @@ connect(
     const operation_config& oc,
     ssl::context& ssl_ctx,
     http_proto::context& proto_ctx,
+    dns_cache& dns,
     any_stream& stream,
     urls::url url)
 {
-    auto org_host = url.host();
-    auto executor = co_await asio::this_coro::executor;
+    auto org_host    = url.host();
+    auto session_key = connection_pool::key(oc, ssl_ctx, url);
+    auto executor    = co_await asio::this_coro::executor;
 
     if(!oc.unix_socket_path.empty())
     {
@@ -239,7 +249,7 @@ connect(
         if(url.scheme_id() == urls::scheme::https)
         {
             stream = co_await perform_tls_handshake(
-                ssl_ctx, std::move(socket), org_host);
+                ssl_ctx, std::move(socket), org_host, session_key);
             co_return;
         }
         stream = std::move(socket);
@@ -258,11 +268,12 @@ connect(
     {
         if(oc.proxy.scheme() == "http")
         {
-            co_await connect_http_proxy(oc, proto_ctx, socket, url, oc.proxy);
+            co_await connect_http_proxy(
+                oc, proto_ctx, dns, socket, url, oc.proxy);
         }
         else if(oc.proxy.scheme() == "socks5")
         {
-            co_await connect_socks5_proxy(socket, url, oc.proxy);
+            co_await connect_socks5_proxy(dns, socket, url, oc.proxy);
         }
         else
         {
@@ -272,23 +283,23 @@ connect(
     }
     else // no proxy
     {
-        auto resolver = asio::ip::tcp::resolver{ executor };
-        auto rresults =
-            co_await resolver.async_resolve(url.host(), effective_port(url));
-
-        co_await asio::async_connect(
-            socket,
-            rresults,
-            [&](const error_code&, const asio::ip::tcp::endpoint& next)
-            {
-                if(oc.ipv4 && next.address().is_v6())
-                    return false;
+        auto rresults = co_await dns.async_resolve(
+            url.host(), std::string{ effective_port(url) });
 
-                if(oc.ipv6 && next.address().is_v4())
-                    return false;
+        auto endpoints = std::vector<asio::ip::tcp::endpoint>{};
+        for(const auto& entry : rresults)
+        {
+            auto address = entry.endpoint().address();
+            if(oc.ipv4 && address.is_v6())
+                continue;
+
+            if(oc.ipv6 && address.is_v4())
+                continue;
+
+            endpoints.push_back(entry.endpoint());
+        }
 
-                return true;
-            });
+        co_await async_connect_racing(socket, std::move(endpoints));
     }
 
     if(oc.tcp_nodelay)
@@ -300,7 +311,7 @@ connect(
     if(url.scheme_id() == urls::scheme::https)
     {
         stream = co_await perform_tls_handshake(
-            ssl_ctx, std::move(socket), org_host);
+            ssl_ctx, std::move(socket), org_host, session_key);
         co_return;
     }
     stream = std::move(socket);
@@ -11,6 +11,7 @@
 #define BURL_CONNECT_HPP
 
 #include "any_stream.hpp"
+#include "dns_cache.hpp"
 #include "options.hpp"
 
 #include <boost/asio/awaitable.hpp>
@@ -28,6 +29,7 @@ connect(
     const operation_config& oc,
     ssl::context& ssl_ctx,
     http_proto::context& proto_ctx,
+    dns_cache& dns,
     any_stream& stream,
     urls::url url);
 
@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "connection_pool.hpp"
+
+#include <cstdint>
+
+connection_pool::connection_pool(
+    std::size_t max_per_origin,
+    ch::steady_clock::duration max_idle)
+    : max_per_origin_{ max_per_origin }
+    , max_idle_{ max_idle }
+{
+}
+
+std::string
+connection_pool::key(
+    const operation_config& oc,
+    const ssl::context& ssl_ctx,
+    const urls::url_view& url)
+{
+    auto rs = std::string{ url.scheme() };
+    rs.append("://");
+    rs.append(url.encoded_host());
+    rs.push_back(':');
+    rs.append(url.has_port() ? url.port() : url.scheme());
+
+    rs.push_back(' ');
+    rs.append(oc.proxy.buffer());
+    rs.push_back(' ');
+    rs.append(oc.unix_socket_path.string());
+    rs.push_back(' ');
+    rs.push_back(oc.ipv4 ? '4' : oc.ipv6 ? '6' : '-');
+
+    if(url.scheme_id() == urls::scheme::https)
+    {
+        rs.push_back(' ');
+        rs.append(std::to_string(
+            reinterpret_cast<std::uintptr_t>(&ssl_ctx)));
+    }
+    return rs;
+}
+
+boost::optional<any_stream>
+connection_pool::acquire(
+    const operation_config& oc,
+    const ssl::context& ssl_ctx,
+    const urls::url_view& url)
+{
+    auto it = idle_.find(key(oc, ssl_ctx, url));
+    if(it == idle_.end())
+        return boost::none;
+
+    auto& entries = it->second;
+    auto now      = ch::steady_clock::now();
+    while(!entries.empty())
+    {
+        // the most recently used is the least likely
+        // to have been closed by the server
+        auto e = std::move(entries.back());
+        entries.pop_back();
+
+        if(now - e.since > max_idle_ || e.stream.is_stale())
+            continue;
+
+        return std::move(e.stream);
+    }
+    idle_.erase(it);
+    return boost::none;
+}
+
+void
+connection_pool::release(
+    const operation_config& oc,
+    const ssl::context& ssl_ctx,
+    const urls::url_view& url,
+    any_stream stream)
+{
+    auto& entries = idle_[key(oc, ssl_ctx, url)];
+    if(entries.size() >= max_per_origin_)
+        entries.erase(entries.begin());
+    entries.push_back({ std::move(stream), ch::steady_clock::now() });
+}
+
+void
+connection_pool::clear() noexcept
+{
+    idle_.clear();
+}
@@ -0,0 +1,93 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_CONNECTION_POOL_HPP
+#define BURL_CONNECTION_POOL_HPP
+
+#include "any_stream.hpp"
+#include "options.hpp"
+
+#include <boost/asio/ssl/context.hpp>
+#include <boost/optional/optional.hpp>
+#include <boost/url/url_view.hpp>
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ch   = std::chrono;
+namespace ssl  = boost::asio::ssl;
+namespace urls = boost::urls;
+
+/** Idle keep-alive connections shared by all transfers
+
+    Connections are keyed by everything that decides
+    where and how they were dialed: the origin, the
+    proxy, the unix socket path, the address family
+    and the TLS context. A transfer checks out a
+    matching connection instead of dialing, and
+    returns it once its response has been read in
+    full.
+*/
+class connection_pool
+{
+    struct entry
+    {
+        any_stream stream;
+        ch::steady_clock::time_point since;
+    };
+
+    std::unordered_map<std::string, std::vector<entry>> idle_;
+    std::size_t max_per_origin_;
+    ch::steady_clock::duration max_idle_;
+
+public:
+    explicit connection_pool(
+        std::size_t max_per_origin          = 8,
+        ch::steady_clock::duration max_idle = ch::seconds{ 30 });
+
+    /** Return an idle connection for the URL, if any
+
+        Connections found closed by the server or idle
+        for too long are discarded.
+    */
+    boost::optional<any_stream>
+    acquire(
+        const operation_config& oc,
+        const ssl::context& ssl_ctx,
+        const urls::url_view& url);
+
+    /** Keep a connection for later transfers
+
+        The response on it must have been read in full.
+    */
+    void
+    release(
+        const operation_config& oc,
+        const ssl::context& ssl_ctx,
+        const urls::url_view& url,
+        any_stream stream);
+
+    void
+    clear() noexcept;
+
+    /** Return the key of connections dialed for the URL
+
+        Two transfers whose keys are equal can use
+        the same connection.
+    */
+    static std::string
+    key(
+        const operation_config& oc,
+        const ssl::context& ssl_ctx,
+        const urls::url_view& url);
+};
+
+#endif
@@ -8,14 +8,21 @@
 //
 
 #include "cookie.hpp"
+#include "mapped_file.hpp"
 
+#include <boost/scope/scope_fail.hpp>
 #include <boost/url/grammar.hpp>
 #include <boost/url/grammar/all_chars.hpp>
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <sstream>
 
 namespace grammar = boost::urls::grammar;
+namespace scope   = boost::scope;
 
 namespace
 {
@@ -58,47 +65,64 @@ constexpr auto value_chars = value_chars_t{};
 constexpr auto attr_chars =
     urls::grammar::all_chars - urls::grammar::lut_chars("\x1F\x7f;");
 
-bool
-domain_match(
-    core::string_view r_domain,
-    core::string_view c_domain,
-    bool tailmatch) noexcept
+core::string_view
+domain_key(core::string_view domain) noexcept
 {
-    if(!tailmatch)
-        return r_domain == c_domain;
-
-    if(c_domain.starts_with('.'))
-        c_domain.remove_prefix(1);
-
-    if(r_domain.ends_with(c_domain))
-    {
-        if(r_domain.size() == c_domain.size())
-            return true;
-
-        return r_domain[r_domain.size() - c_domain.size() - 1] == '.';
-    }
-
-    return false;
+    if(domain.starts_with('.'))
+        domain.remove_prefix(1);
+    return domain;
 }
 
-bool
-path_match(core::string_view r_path, core::string_view c_path) noexcept
+// The cookie paths that match a request path are its
+// prefixes ending just before or just after a '/', and
+// the path itself.
+template<typename F>
+void
+for_each_matching_path(core::string_view r_path, F&& f)
 {
-    if(r_path.empty())
-        return true;
-
-    if(r_path.starts_with(c_path))
+    auto last = std::size_t(-1);
+    auto emit = [&](std::size_t n)
     {
-        if(r_path.size() == c_path.size())
-            return true;
-
-        if(c_path.ends_with('/'))
-            return true;
+        if(n != last)
+            f(r_path.substr(0, n));
+        last = n;
+    };
 
-        return r_path[r_path.size() - c_path.size()] == '/';
+    for(auto i = std::size_t{}; i != r_path.size(); ++i)
+    {
+        if(r_path[i] == '/')
+        {
+            emit(i);
+            emit(i + 1);
+        }
     }
+    emit(r_path.size());
+}
 
-    return false;
+void
+append_netscape_line(std::string& s, const cookie& c)
+{
+    if(c.http_only)
+        s.append("#HttpOnly_");
+    s.append(c.domain.value());
+    s.append(c.tailmatch ? "\tTRUE\t" : "\tFALSE\t");
+    s.append(c.path.value());
+    s.append(c.secure ? "\tTRUE\t" : "\tFALSE\t");
+
+    auto epoch = std::int64_t{};
+    if(c.expires)
+        epoch = ch::duration_cast<ch::seconds>(
+                    c.expires.value().time_since_epoch())
+                    .count();
+    char buf[20];
+    s.append(buf, std::to_chars(buf, buf + sizeof(buf), epoch).ptr);
+
+    s.push_back('\t');
+    s.append(c.name);
+    s.push_back('\t');
+    if(c.value)
+        s.append(c.value.value());
+    s.push_back('\n');
 }
 
 ch::system_clock::time_point
@@ -276,6 +300,87 @@ parse_netscape_cookie(core::string_view sv)
     return rs;
 }
 
+void
+cookie_jar::insert(cookie c, time_point now)
+{
+    auto key    = domain_key(c.domain.value());
+    auto bucket = buckets_.find(key);
+    if(bucket == buckets_.end())
+        bucket = buckets_.emplace(key, std::vector<cookie>{}).first;
+
+    auto& cookies = bucket->second;
+    auto by_path  = [](const cookie& a, const cookie& b)
+    { return a.path.value() < b.path.value(); };
+
+    auto [first, last] =
+        std::equal_range(cookies.begin(), cookies.end(), c, by_path);
+    auto it = std::find_if(
+        first,
+        last,
+        [&](const cookie& o)
+        { return c.name == o.name && c.domain == o.domain; });
+    if(it != last)
+    {
+        if(it->expires.has_value())
+            --expiring_;
+        cookies.erase(it);
+    }
+
+    // Check expiry date last to allow servers to remove cookies
+    if(c.expires.has_value())
+    {
+        if(c.expires.value() < now)
+        {
+            if(cookies.empty())
+                buckets_.erase(bucket);
+            return;
+        }
+        expiries_.emplace(c.expires.value(), bucket->first);
+        ++expiring_;
+    }
+
+    cookies.insert(
+        std::upper_bound(cookies.begin(), cookies.end(), c, by_path),
+        std::move(c));
+
+    if(expiries_.size() > 2 * expiring_ + 16)
+        compact_expiries();
+}
+
+// Rebuild the expiry queue from the stored cookies,
+// dropping the entries of cookies that were replaced
+void
+cookie_jar::compact_expiries()
+{
+    auto entries = std::vector<expiry>{};
+    entries.reserve(expiring_);
+    for(const auto& [key, cookies] : buckets_)
+        for(const auto& c : cookies)
+            if(c.expires.has_value())
+                entries.emplace_back(c.expires.value(), key);
+    expiries_ = decltype(expiries_){ std::greater<>{}, std::move(entries) };
+}
+
+void
+cookie_jar::remove_expired(time_point now)
+{
+    while(!expiries_.empty() && expiries_.top().first <= now)
+    {
+        // The entry is stale if the cookie was replaced
+        if(auto it = buckets_.find(expiries_.top().second);
+           it != buckets_.end())
+        {
+            expiring_ -= std::erase_if(
+                it->second,
+                [&](const cookie& c)
+                { return c.expires.has_value() && c.expires <= now; });
+            if(it->second.empty())
+                buckets_.erase(it);
+        }
+        expiries_.pop();
+    }
+}
+
 void
 cookie_jar::add(const urls::url_view& url, cookie c)
 {
@@ -306,22 +411,7 @@ cookie_jar::add(const urls::url_view& url, cookie c)
     if(c.secure && url.scheme_id() != urls::scheme::https)
         return;
 
-    cookies_.erase(
-        std::remove_if(
-            cookies_.begin(),
-            cookies_.end(),
-            [&](const cookie& o)
-            {
-                return c.name == o.name && c.path == o.path &&
-                    c.domain == o.domain;
-            }),
-        cookies_.end());
-
-    // Check expiry date last to allow servers to remove cookies
-    if(c.expires.has_value() && c.expires.value() < ch::system_clock::now())
-        return;
-
-    cookies_.push_back(std::move(c));
+    insert(std::move(c), ch::system_clock::now());
 }
 
 std::string
@@ -330,29 +420,75 @@ cookie_jar::make_field(const urls::url_view& url)
     const auto r_domain    = url.host();
     const auto r_path      = url.encoded_path();
     const auto r_is_secure = url.scheme_id() == urls::scheme::https;
-    const auto now         = ch::system_clock::now();
 
-    auto rs = std::string{};
-    for(auto it = cookies_.begin(); it != cookies_.end();)
+    remove_expired(ch::system_clock::now());
+
+    auto matches = std::vector<const cookie*>{};
+    auto collect = [&](const cookie& c, bool host_only_ok)
     {
-        if(it->expires.has_value() && it->expires <= now)
-        {
-            it = cookies_.erase(it);
-            continue;
-        }
+        if(!c.tailmatch && !host_only_ok)
+            return;
 
-        if(domain_match(r_domain, it->domain.value(), it->tailmatch) &&
-           path_match(r_path, it->path.value()) &&
-           (it->secure ? r_is_secure : true))
+        if(c.secure && !r_is_secure)
+            return;
+
+        matches.push_back(&c);
+    };
+
+    // Probe the host itself, then each parent domain,
+    // where only domain cookies apply
+    auto domain = core::string_view{ r_domain };
+    for(auto exact = true;; exact = false)
+    {
+        if(auto it = buckets_.find(domain); it != buckets_.end())
         {
-            rs.append(it->name);
-            rs.push_back('=');
-            if(it->value.has_value())
-                rs.append(*it->value);
-            rs.append("; ");
+            const auto& cookies = it->second;
+            if(r_path.empty())
+            {
+                for(const auto& c : cookies)
+                    collect(c, exact);
+            }
+            else
+            {
+                for_each_matching_path(
+                    r_path,
+                    [&](core::string_view path)
+                    {
+                        auto first = std::lower_bound(
+                            cookies.begin(),
+                            cookies.end(),
+                            path,
+                            [](const cookie& c, core::string_view p)
+                            { return c.path.value() < p; });
+                        for(; first != cookies.end() &&
+                            first->path.value() == path;
+                            ++first)
+                            collect(*first, exact);
+                    });
+            }
         }
 
-        ++it;
+        auto dot = domain.find('.');
+        if(dot == core::string_view::npos)
+            break;
+        domain.remove_prefix(dot + 1);
+    }
+
+    // Cookies with longer paths are listed first
+    std::stable_sort(
+        matches.begin(),
+        matches.end(),
+        [](const cookie* a, const cookie* b)
+        { return a->path->size() > b->path->size(); });
+
+    auto rs = std::string{};
+    for(const auto* c : matches)
+    {
+        rs.append(c->name);
+        rs.push_back('=');
+        if(c->value.has_value())
+            rs.append(*c->value);
+        rs.append("; ");
     }
     return rs;
 }
@@ -360,12 +496,89 @@ cookie_jar::make_field(const urls::url_view& url)
 void
 cookie_jar::clear_session_cookies()
 {
-    cookies_.erase(
-        std::remove_if(
-            cookies_.begin(),
-            cookies_.end(),
-            [](const cookie& c) { return !c.expires.has_value(); }),
-        cookies_.end());
+    for(auto it = buckets_.begin(); it != buckets_.end();)
+    {
+        std::erase_if(
+            it->second, [](const cookie& c) { return !c.expires.has_value(); });
+        if(it->second.empty())
+            it = buckets_.erase(it);
+        else
+            ++it;
+    }
+}
+
+void
+cookie_jar::load_line(core::string_view line, time_point now)
+{
+    if(line.ends_with('\r'))
+        line.remove_suffix(1);
+
+    if(line.empty())
+        return;
+
+    // skip comments
+    if(line.starts_with('#') && !line.starts_with("#HttpOnly_"))
+        return;
+
+    insert(parse_netscape_cookie(line).value(), now);
+}
+
+void
+cookie_jar::load(const fs::path& path)
+{
+    const auto file = mapped_file{ path };
+    const auto now  = ch::system_clock::now();
+
+    for(auto sv = file.view(); !sv.empty();)
+    {
+        auto* nl = static_cast<const char*>(
+            std::memchr(sv.data(), '\n', sv.size()));
+        auto n = nl ? static_cast<std::size_t>(nl - sv.data()) : sv.size();
+        load_line(sv.substr(0, n), now);
+        sv.remove_prefix(nl ? n + 1 : n);
+    }
+}
+
+void
+cookie_jar::save(const fs::path& path) const
+{
+    auto tmp = path;
+    tmp += ".tmp";
+
+    auto scope_fail = scope::make_scope_fail(
+        [&]
+        {
+            auto ec = std::error_code{};
+            fs::remove(tmp, ec);
+        });
+
+    auto os = std::ofstream{ tmp, std::ios::binary | std::ios::trunc };
+    if(!os.is_open())
+        throw std::runtime_error{ "Couldn't open file" };
+    os.exceptions(std::ofstream::badbit | std::ofstream::failbit);
+
+    // Lines are formatted into a large buffer and written
+    // in a few calls rather than one stream insertion per
+    // field
+    constexpr auto flush_size = std::size_t{ 64 * 1024 };
+    auto buf = std::string{ "# Netscape HTTP Cookie File\n\n" };
+    buf.reserve(flush_size + 4096);
+    for(const auto& [_, cookies] : buckets_)
+    {
+        for(const auto& c : cookies)
+        {
+            append_netscape_line(buf, c);
+            if(buf.size() >= flush_size)
+            {
+                os.write(buf.data(), buf.size());
+                buf.clear();
+            }
+        }
+    }
+    os.write(buf.data(), buf.size());
+    os.close();
+
+    fs::rename(tmp, path);
 }
 
 std::ostream&
@@ -373,23 +586,15 @@ operator<<(std::ostream& os, const cookie_jar& cj)
 {
     os << "# Netscape HTTP Cookie File\n\n";
 
-    for(const auto& c : cj.cookies_)
+    auto line = std::string{};
+    for(const auto& [_, cookies] : cj.buckets_)
     {
-        os << (c.http_only ? "#HttpOnly_" : "");
-        os << c.domain.value() << '\t';
-        os << (c.tailmatch ? "TRUE" : "FALSE") << '\t';
-        os << c.path.value() << '\t';
-        os << (c.secure ? "TRUE" : "FALSE") << '\t';
-        if(c.expires)
-            os << ch::duration_cast<ch::seconds>(
-                      c.expires.value().time_since_epoch())
-                      .count();
-        else
-            os << '0';
-        os << '\t';
-        os << c.name << '\t';
-        os << c.value.value_or("");
-        os << '\n';
+        for(const auto& c : cookies)
+        {
+            line.clear();
+            append_netscape_line(line, c);
+            os << line;
+        }
     }
     return os;
 }
@@ -397,16 +602,8 @@ operator<<(std::ostream& os, const cookie_jar& cj)
 std::istream&
 operator>>(std::istream& is, cookie_jar& cj)
 {
+    const auto now = ch::system_clock::now();
     for(std::string line; getline(is, line);)
-    {
-        if(line.empty())
-            continue;
-
-        // skip comments
-        if(line.starts_with('#') && !line.starts_with("#HttpOnly_"))
-            continue;
-
-        cj.cookies_.push_back(parse_netscape_cookie(line).value());
-    }
+        cj.load_line(line, now);
     return is;
 }
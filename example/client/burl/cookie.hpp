@@ -14,11 +14,17 @@
 #include <boost/url/url_view.hpp>
 
 #include <chrono>
+#include <filesystem>
+#include <functional>
 #include <iostream>
-#include <list>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace ch   = std::chrono;
 namespace core = boost::core;
+namespace fs   = std::filesystem;
 namespace urls = boost::urls;
 
 struct cookie
@@ -45,9 +51,59 @@ struct cookie
 boost::system::result<cookie>
 parse_cookie(core::string_view sv);
 
+/** A store of cookies indexed for lookup by URL
+
+    Cookies are bucketed by domain, without the leading
+    dot, and each bucket is kept sorted by path. Making
+    a Cookie field probes the buckets of the host and of
+    each of its parent domains, and within a bucket only
+    the paths that can match the request path, so the
+    cost follows the number of matching cookies rather
+    than the size of the jar.
+
+    Expired cookies are dropped lazily, in order of
+    expiry, the next time the jar is used. Replacing a
+    cookie leaves its old expiry queued, and the queue
+    is rebuilt once such entries outnumber the live
+    ones.
+*/
 class cookie_jar
 {
-    std::list<cookie> cookies_;
+    struct string_hash
+    {
+        using is_transparent = void;
+
+        std::size_t
+        operator()(std::string_view sv) const noexcept
+        {
+            return std::hash<std::string_view>{}(sv);
+        }
+    };
+
+    using time_point = ch::system_clock::time_point;
+    using expiry     = std::pair<time_point, std::string>;
+
+    std::unordered_map<
+        std::string,
+        std::vector<cookie>,
+        string_hash,
+        std::equal_to<>>
+        buckets_;
+    std::priority_queue<expiry, std::vector<expiry>, std::greater<>>
+        expiries_;
+    std::size_t expiring_ = 0; // stored cookies with an expiry
+
+    void
+    insert(cookie c, time_point now);
+
+    void
+    remove_expired(time_point now);
+
+    void
+    compact_expiries();
+
+    void
+    load_line(core::string_view line, time_point now);
 
 public:
     void
@@ -59,6 +115,24 @@ public:
     void
     clear_session_cookies();
 
+    /** Add the cookies of a Netscape cookie file
+
+        The file is memory mapped and parsed in place.
+
+        @throws boost::system::system_error
+    */
+    void
+    load(const fs::path& path);
+
+    /** Write the jar as a Netscape cookie file
+
+        The cookies are written to a temporary file that
+        then replaces the target, so readers never see a
+        partially written jar.
+    */
+    void
+    save(const fs::path& path) const;
+
     friend
     std::ostream&
     operator<<(std::ostream& os, const cookie_jar& cj);
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "dns_cache.hpp"
+
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/core/detail/string_view.hpp>
+#include <boost/optional/optional.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <charconv>
+
+using system_error = boost::system::system_error;
+
+namespace
+{
+namespace core = boost::core;
+
+boost::optional<asio::ip::tcp::endpoint>
+literal_endpoint(core::string_view host, core::string_view port)
+{
+    if(host.size() > 2 && host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+
+    auto ec   = error_code{};
+    auto addr = asio::ip::make_address(std::string{ host }, ec);
+    if(ec)
+        return boost::none;
+
+    auto num = std::uint16_t{};
+    auto rs  = std::from_chars(port.data(), port.data() + port.size(), num);
+    if(rs.ec != std::errc{} || rs.ptr != port.data() + port.size())
+        return boost::none;
+
+    return asio::ip::tcp::endpoint{ addr, num };
+}
+} // namespace
+
+dns_cache::dns_cache(
+    ch::steady_clock::duration ttl,
+    ch::steady_clock::duration negative_ttl)
+    : ttl_{ ttl }
+    , negative_ttl_{ negative_ttl }
+{
+}
+
+asio::awaitable<dns_cache::results_type>
+dns_cache::async_resolve(std::string host, std::string port)
+{
+    if(auto ep = literal_endpoint(host, port))
+        co_return results_type::create(ep.value(), host, port);
+
+    auto executor = co_await asio::this_coro::executor;
+    auto key      = host + ':' + port;
+
+    for(;;)
+    {
+        if(auto it = entries_.find(key); it != entries_.end())
+        {
+            auto& e = it->second;
+            if(e.pending)
+            {
+                // Another transfer is looking up the same name
+                auto pending = e.pending;
+                co_await pending->async_wait(asio::as_tuple);
+                if(!!(co_await asio::this_coro::cancellation_state).cancelled())
+                    throw system_error{ asio::error::operation_aborted };
+                continue;
+            }
+
+            if(ch::steady_clock::now() < e.expires)
+            {
+                if(e.ec)
+                    throw system_error{ e.ec };
+                co_return e.results;
+            }
+        }
+        break;
+    }
+
+    auto pending = std::make_shared<asio::steady_timer>(
+        executor, asio::steady_timer::time_point::max());
+    entries_[key].pending = pending;
+
+    auto resolver      = asio::ip::tcp::resolver{ executor };
+    auto [ec, results] =
+        co_await resolver.async_resolve(host, port, asio::as_tuple);
+
+    // the map may have been rehashed while suspended
+    auto& e   = entries_[key];
+    e.pending = nullptr;
+    e.results = results;
+    e.ec      = ec;
+    e.expires = ch::steady_clock::now() + (ec ? negative_ttl_ : ttl_);
+
+    // A cancelled lookup says nothing about the name
+    if(ec == asio::error::operation_aborted)
+        e.expires = {};
+
+    pending->cancel();
+
+    if(ec)
+        throw system_error{ ec };
+    co_return results;
+}
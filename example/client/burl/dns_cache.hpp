@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_DNS_CACHE_HPP
+#define BURL_DNS_CACHE_HPP
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace asio   = boost::asio;
+namespace ch     = std::chrono;
+using error_code = boost::system::error_code;
+
+/** A cache of host name lookups shared by all transfers
+
+    Successful lookups are kept for a fixed time, and
+    failed ones for a shorter time so a missing host
+    is not looked up again by every transfer. When
+    several transfers look up the same name at once,
+    only the first performs the lookup and the others
+    wait for its result.
+
+    Addresses given literally, including those that
+    --resolve substitutes, never reach the resolver.
+*/
+class dns_cache
+{
+public:
+    using results_type = asio::ip::tcp::resolver::results_type;
+
+    explicit dns_cache(
+        ch::steady_clock::duration ttl          = ch::seconds{ 60 },
+        ch::steady_clock::duration negative_ttl = ch::seconds{ 5 });
+
+    /** Resolve a host and port
+
+        @throws boost::system::system_error
+    */
+    asio::awaitable<results_type>
+    async_resolve(std::string host, std::string port);
+
+private:
+    struct entry
+    {
+        results_type results;
+        error_code ec;
+        ch::steady_clock::time_point expires;
+
+        // non-null while a lookup is in flight,
+        // cancelled to wake the waiters
+        std::shared_ptr<asio::steady_timer> pending;
+    };
+
+    std::unordered_map<std::string, entry> entries_;
+    ch::steady_clock::duration ttl_;
+    ch::steady_clock::duration negative_ttl_;
+};
+
+#endif
@@ -9,6 +9,15 @@
 
 #include "error.hpp"
 
+#include <boost/system/system_error.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
 namespace
 {
 const boost::system::error_category&
@@ -44,3 +53,32 @@ make_error_code(error e)
 {
     return { static_cast<int>(e), error_category() };
 }
+
+boost::system::error_code
+last_system_error() noexcept
+{
+#ifdef _WIN32
+    return { static_cast<int>(::GetLastError()),
+             boost::system::system_category() };
+#else
+    return { errno, boost::system::system_category() };
+#endif
+}
+
+void
+throw_last_error(const char* what)
+{
+    throw boost::system::system_error{ last_system_error(), what };
+}
+
+void
+close_and_throw(native_file f, const char* what)
+{
+    auto ec = last_system_error();
+#ifdef _WIN32
+    ::CloseHandle(static_cast<HANDLE>(f));
+#else
+    ::close(f);
+#endif
+    throw boost::system::system_error{ ec, what };
+}
@@ -31,4 +31,31 @@ struct is_error_code_enum<error> : std::true_type
 std::error_code
 make_error_code(error e);
 
+#ifdef _WIN32
+using native_file = void*;
+#else
+using native_file = int;
+#endif
+
+/// Return errno, or GetLastError() on Windows
+boost::system::error_code
+last_system_error() noexcept;
+
+/** Throw @ref last_system_error
+
+    @throws boost::system::system_error
+*/
+[[noreturn]] void
+throw_last_error(const char* what);
+
+/** Close a file and throw the error that came before
+
+    The error is taken before the file is closed, so
+    closing it can't replace the error.
+
+    @throws boost::system::system_error
+*/
+[[noreturn]] void
+close_and_throw(native_file f, const char* what);
+
 #endif
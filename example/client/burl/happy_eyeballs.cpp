@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "happy_eyeballs.hpp"
+#include "task_group.hpp"
+
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/optional/optional.hpp>
+#include <boost/system/system_error.hpp>
+
+using system_error = boost::system::system_error;
+using tcp          = asio::ip::tcp;
+
+namespace
+{
+// Alternate the address families, starting with the
+// one the resolver put first (RFC 8305 section 4).
+std::vector<tcp::endpoint>
+interleave(const std::vector<tcp::endpoint>& endpoints)
+{
+    auto preferred = std::vector<tcp::endpoint>{};
+    auto other     = std::vector<tcp::endpoint>{};
+    for(const auto& ep : endpoints)
+    {
+        if(ep.protocol() == endpoints.front().protocol())
+            preferred.push_back(ep);
+        else
+            other.push_back(ep);
+    }
+
+    auto rs = std::vector<tcp::endpoint>{};
+    rs.reserve(endpoints.size());
+    for(auto i = std::size_t{}; i < preferred.size() || i < other.size(); ++i)
+    {
+        if(i < preferred.size())
+            rs.push_back(preferred[i]);
+        if(i < other.size())
+            rs.push_back(other[i]);
+    }
+    return rs;
+}
+} // namespace
+
+asio::awaitable<void>
+async_connect_racing(
+    tcp::socket& socket,
+    std::vector<tcp::endpoint> endpoints,
+    ch::steady_clock::duration attempt_delay)
+{
+    if(endpoints.empty())
+        throw system_error{ asio::error::not_found };
+
+    endpoints = interleave(endpoints);
+
+    // The attempts refer to this frame, it must not be
+    // left before they are all joined
+    co_await asio::this_coro::throw_if_cancelled(false);
+
+    auto executor = socket.get_executor();
+    auto tg       = task_group{ executor,
+                          static_cast<std::uint32_t>(endpoints.size()) };
+    auto wake     = asio::steady_timer{ executor };
+    auto winner   = boost::optional<tcp::socket>{};
+    auto last_ec  = error_code{};
+    auto ep       = std::exception_ptr{};
+
+    auto attempt = [&](tcp::endpoint endpoint) -> asio::awaitable<void>
+    {
+        auto s    = tcp::socket{ executor };
+        auto [ec] = co_await s.async_connect(endpoint, asio::as_tuple);
+
+        if(!ec && !winner)
+        {
+            winner.emplace(std::move(s));
+            tg.emit(asio::cancellation_type::terminal);
+        }
+        else if(ec && ec != asio::error::operation_aborted)
+        {
+            last_ec = ec;
+        }
+
+        // A failure starts the next attempt right away
+        wake.cancel();
+    };
+
+    for(auto it = endpoints.begin(); it != endpoints.end(); ++it)
+    {
+        auto [ec, handler] = co_await tg.async_adapt(
+            [&](std::exception_ptr e)
+            {
+                if(e && !ep)
+                    ep = e;
+            },
+            asio::as_tuple);
+        if(ec)
+            break;
+
+        asio::co_spawn(executor, attempt(*it), std::move(handler));
+
+        if(std::next(it) == endpoints.end())
+            break;
+
+        wake.expires_after(attempt_delay);
+        co_await wake.async_wait(asio::as_tuple);
+
+        if(winner ||
+           !!(co_await asio::this_coro::cancellation_state).cancelled())
+            break;
+    }
+
+    if(!!(co_await asio::this_coro::cancellation_state).cancelled())
+        tg.emit(asio::cancellation_type::terminal);
+
+    co_await tg.async_join();
+
+    if(winner)
+    {
+        socket = std::move(*winner);
+        co_return;
+    }
+
+    if(ep)
+        std::rethrow_exception(ep);
+
+    if(!!(co_await asio::this_coro::cancellation_state).cancelled())
+        throw system_error{ asio::error::operation_aborted };
+
+    if(!last_ec)
+        last_ec = asio::error::not_found;
+    throw system_error{ last_ec };
+}
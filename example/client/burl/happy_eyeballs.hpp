@@ -0,0 +1,44 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_HAPPY_EYEBALLS_HPP
+#define BURL_HAPPY_EYEBALLS_HPP
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace ch   = std::chrono;
+
+/** Connect to the first endpoint that answers
+
+    The endpoints are reordered so that address
+    families alternate, starting with the family of
+    the first one. Attempts are started one after
+    another, each after the previous one failed or
+    after a delay, and run concurrently until one of
+    them succeeds. The rest are then cancelled.
+
+    This follows the connection racing part of
+    RFC 8305, so a blackholed address costs a delay
+    instead of a full connect timeout.
+
+    @throws boost::system::system_error with the
+    error of the last attempt if none succeeds.
+*/
+asio::awaitable<void>
+async_connect_racing(
+    asio::ip::tcp::socket& socket,
+    std::vector<asio::ip::tcp::endpoint> endpoints,
+    ch::steady_clock::duration attempt_delay = ch::milliseconds{ 250 });
+
+#endif
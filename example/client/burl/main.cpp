@@ -11,12 +11,16 @@
 #include "any_stream.hpp"
 #include "base64.hpp"
 #include "connect.hpp"
+#include "connection_pool.hpp"
 #include "cookie.hpp"
 #include "error.hpp"
 #include "message.hpp"
+#include "positional_file.hpp"
+#include "progress_aggregator.hpp"
 #include "progress_meter.hpp"
 #include "request.hpp"
 #include "task_group.hpp"
+#include "tls_session_cache.hpp"
 #include "utils.hpp"
 
 #include <boost/asio/as_tuple.hpp>
@@ -33,11 +37,14 @@
 #include <boost/http_proto.hpp>
 #include <boost/scope/scope_exit.hpp>
 #include <boost/scope/scope_fail.hpp>
+#include <boost/url/grammar/ci_string.hpp>
 #include <boost/url/parse.hpp>
 #include <boost/url/url.hpp>
 
+#include <charconv>
 #include <cstdlib>
 
+namespace grammar  = boost::urls::grammar;
 namespace http_io  = boost::http_io;
 namespace scope    = boost::scope;
 using system_error = boost::system::system_error;
@@ -108,6 +115,43 @@ is_transient_error(http_proto::status status) noexcept
     }
 }
 
+// Returns true if a request which failed on a pooled
+// connection may be sent again on a new one. A clean
+// close before any response byte means the server
+// dropped the connection while idle, so any method
+// qualifies. After a reset the server may have acted
+// on the request, and only idempotent methods are safe
+// to repeat (RFC 9110 9.2.2).
+bool
+is_stale_connection_error(
+    http_proto::method method,
+    const boost::system::error_code& ec,
+    bool got_header) noexcept
+{
+    if(ec == http_proto::error::end_of_stream)
+        return true;
+
+    if(got_header)
+        return false;
+
+    if(ec != asio::error::connection_reset && ec != asio::error::broken_pipe &&
+       ec != asio::error::eof)
+        return false;
+
+    switch(method)
+    {
+    case http_proto::method::get:
+    case http_proto::method::head:
+    case http_proto::method::put:
+    case http_proto::method::delete_:
+    case http_proto::method::options:
+    case http_proto::method::trace:
+        return true;
+    default:
+        return false;
+    }
+}
+
 bool
 can_reuse_connection(
     http_proto::response_view response,
@@ -162,6 +206,16 @@ redirect_url(http_proto::response_view response, const urls::url_view& referer)
     throw std::runtime_error{ "Bad redirect response" };
 }
 
+// The URL as listed in the progress dashboard, without
+// the userinfo or the query, which may hold credentials
+std::string
+progress_name(const urls::url_view& url)
+{
+    auto rs = std::string{ url.encoded_host_and_port() };
+    rs.append(url.encoded_path());
+    return rs;
+}
+
 asio::awaitable<void>
 report_progress(progress_meter& pm)
 {
@@ -315,6 +369,277 @@ struct null_sink : http_proto::sink
     }
 };
 
+class range_sink : public http_proto::sink
+{
+    positional_file* file_;
+    std::uint64_t offset_;
+    progress_meter* pm_;
+
+public:
+    range_sink(positional_file* file, std::uint64_t offset, progress_meter* pm)
+        : file_{ file }
+        , offset_{ offset }
+        , pm_{ pm }
+    {
+    }
+
+    results
+    on_write(buffers::const_buffer cb, bool) override
+    {
+        try
+        {
+            file_->write_at(offset_, cb);
+        }
+        catch(const system_error& e)
+        {
+            return { e.code() };
+        }
+        offset_ += cb.size();
+        pm_->update(cb.size());
+        return { {}, cb.size() };
+    }
+};
+
+bool
+accepts_byte_ranges(http_proto::response_view response) noexcept
+{
+    for(auto sv : response.find_all(http_proto::field::accept_ranges))
+        if(grammar::ci_is_equal(sv, "bytes"))
+            return true;
+    return false;
+}
+
+boost::optional<std::uint64_t>
+content_length(http_proto::response_view response) noexcept
+{
+    auto it = response.find(http_proto::field::content_length);
+    if(it == response.end())
+        return boost::none;
+
+    auto value = std::uint64_t{};
+    auto sv    = it->value;
+    auto rs    = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    if(rs.ec != std::errc{} || rs.ptr != sv.data() + sv.size())
+        return boost::none;
+    return value;
+}
+
+// Return the validator to send in If-Range, which
+// must be strong: an entity tag unless it is weak,
+// else the modification date.
+boost::optional<std::string>
+range_validator(http_proto::response_view response)
+{
+    auto it = response.find(http_proto::field::etag);
+    if(it != response.end() && !it->value.starts_with("W/"))
+        return std::string{ it->value };
+
+    it = response.find(http_proto::field::last_modified);
+    if(it != response.end())
+        return std::string{ it->value };
+    return boost::none;
+}
+
+bool
+is_content_range(
+    http_proto::response_view response,
+    std::uint64_t first,
+    std::uint64_t last,
+    std::uint64_t total) noexcept
+{
+    auto it = response.find(http_proto::field::content_range);
+    if(it == response.end())
+        return false;
+
+    auto sv = it->value;
+    auto expect = [&](core::string_view prefix, std::uint64_t value)
+    {
+        if(!sv.starts_with(prefix))
+            return false;
+        sv.remove_prefix(prefix.size());
+        auto parsed = std::uint64_t{};
+        auto rs     = std::from_chars(sv.data(), sv.data() + sv.size(), parsed);
+        if(rs.ec != std::errc{} || parsed != value)
+            return false;
+        sv.remove_prefix(static_cast<std::size_t>(rs.ptr - sv.data()));
+        return true;
+    };
+    return expect("bytes ", first) && expect("-", last) &&
+        expect("/", total) && sv.empty();
+}
+
+// Download a resource over several range requests at
+// once, each on its own connection, writing every range
+// in place. Returns false without creating the output
+// if the server doesn't support ranges or the resource
+// is too small to be worth splitting, and false after
+// creating it if the resource changed or a server sent
+// a range other than the one asked for, so the caller
+// downloads it again over a single connection.
+asio::awaitable<bool>
+segmented_download(
+    const operation_config& oc,
+    ssl::context& ssl_ctx,
+    http_proto::context& proto_ctx,
+    connection_pool& conn_pool,
+    dns_cache& dns,
+    progress_aggregator& progress,
+    http_proto::request request,
+    const urls::url_view& url,
+    const fs::path& output_path)
+{
+    using field      = http_proto::field;
+    auto executor    = co_await asio::this_coro::executor;
+    auto segments    = std::uint64_t{ oc.segments };
+    auto min_segment = std::uint64_t{ 1024 * 1024 };
+
+    auto dial = [&](any_stream& stream) -> asio::awaitable<void>
+    {
+        if(auto idle = conn_pool.acquire(oc, ssl_ctx, url))
+        {
+            stream = std::move(idle.value());
+            co_return;
+        }
+
+        co_await asio::co_spawn(
+            executor,
+            connect(oc, ssl_ctx, proto_ctx, dns, stream, url),
+            asio::cancel_after(oc.connect_timeout));
+
+        stream.read_limit(oc.recv_limiter);
+        stream.write_limit(oc.send_limiter);
+    };
+
+    // ranges apply to the encoded representation
+    request.erase(field::accept_encoding);
+    request.erase(field::range);
+
+    // Probe for the size and range support
+    auto total     = std::uint64_t{};
+    auto validator = std::string{};
+    {
+        auto stream     = any_stream{ asio::ip::tcp::socket{ executor } };
+        auto parser     = http_proto::response_parser{ proto_ctx };
+        auto serializer = http_proto::serializer{ proto_ctx };
+
+        co_await dial(stream);
+        request.set_method(http_proto::method::head);
+        serializer.start(request);
+        parser.reset();
+        parser.start_head_response();
+        co_await async_request(
+            stream, serializer, parser, nullptr, oc.expect100timeout);
+
+        auto response = parser.get();
+        auto size     = content_length(response);
+        if(can_reuse_connection(response, url, url))
+            conn_pool.release(oc, ssl_ctx, url, std::move(stream));
+
+        // Without a validator, ranges of a resource
+        // changed after the probe would be spliced.
+        auto v = range_validator(response);
+        if(response.status() != http_proto::status::ok ||
+           !accepts_byte_ranges(response) || !size || !v)
+            co_return false;
+        validator = std::move(v.value());
+
+        total    = size.value();
+        segments = std::min(segments, total / min_segment);
+        if(segments < 2)
+            co_return false;
+    }
+
+    auto scope_fail = scope::make_scope_fail(
+        [&]
+        {
+            if(oc.rm_partial)
+                fs::remove(output_path);
+        });
+
+    auto file = positional_file{ output_path, total };
+    auto pm   = progress_meter{ total, progress, progress_name(url) };
+    request.set_method(http_proto::method::get);
+    request.set(field::if_range, validator);
+
+    auto mismatch = false;
+    auto fetch    = [&](std::uint64_t first,
+                     std::uint64_t last) -> asio::awaitable<void>
+    {
+        auto stream     = any_stream{ asio::ip::tcp::socket{ executor } };
+        auto parser     = http_proto::response_parser{ proto_ctx };
+        auto serializer = http_proto::serializer{ proto_ctx };
+        auto range      = request;
+
+        range.set(
+            field::range,
+            "bytes=" + std::to_string(first) + "-" + std::to_string(last));
+
+        co_await dial(stream);
+        serializer.start(range);
+        parser.reset();
+        parser.start();
+        co_await async_request(
+            stream, serializer, parser, nullptr, oc.expect100timeout);
+
+        // A full response means the resource changed
+        if(parser.get().status() != http_proto::status::partial_content ||
+           body_size(parser.get()) != last - first + 1 ||
+           !is_content_range(parser.get(), first, last, total))
+        {
+            mismatch = true;
+            throw std::runtime_error{ "Server did not honor the range request" };
+        }
+
+        parser.set_body_limit(last - first + 1);
+        parser.set_body<range_sink>(&file, first, &pm);
+        co_await http_io::async_read(stream, parser);
+
+        if(can_reuse_connection(parser.get(), url, url))
+            conn_pool.release(oc, ssl_ctx, url, std::move(stream));
+    };
+
+    // Cancel the other ranges once one fails
+    auto tg   = task_group{ executor, static_cast<std::uint32_t>(segments) };
+    auto ep   = std::exception_ptr{};
+    auto step = total / segments;
+    for(auto i = std::uint64_t{}; i != segments; ++i)
+    {
+        auto first = i * step;
+        auto last  = i + 1 == segments ? total - 1 : first + step - 1;
+        co_spawn(
+            executor,
+            fetch(first, last),
+            co_await tg.async_adapt(
+                [&](std::exception_ptr e)
+                {
+                    if(e && !ep)
+                    {
+                        ep = e;
+                        tg.emit(asio::cancellation_type::terminal);
+                    }
+                }));
+    }
+
+    if(oc.parallel_max > 1 || oc.noprogress)
+    {
+        co_await tg.async_join();
+    }
+    else
+    {
+        co_await asio::experimental::make_parallel_group(
+            tg.async_join(), co_spawn(executor, report_progress(pm)))
+            .async_wait(asio::experimental::wait_for_one{}, asio::deferred);
+    }
+
+    if(mismatch)
+        co_return false;
+
+    if(ep)
+        std::rethrow_exception(ep);
+
+    co_return true;
+}
+
 asio::awaitable<http_proto::status>
 perform_request(
     operation_config oc,
@@ -323,6 +648,9 @@ perform_request(
     core::string_view exp_cookies,
     ssl::context& ssl_ctx,
     http_proto::context& proto_ctx,
+    connection_pool& conn_pool,
+    dns_cache& dns,
+    progress_aggregator& progress,
     message msg,
     request_opt request_opt)
 {
@@ -420,8 +748,29 @@ perform_request(
     if(oc.skip_existing && fs::exists(output_path))
         co_return http_proto::status::ok;
 
+    auto request = create_request(oc, msg, url);
+
+    // Range requests don't show their headers, carry
+    // cookies or take per-host slots, so transfers which
+    // need any of these use a single connection.
+    if(oc.segments > 1 && output_path != "-" && !oc.resume_from && !oc.range &&
+       request.method() == http_proto::method::get && !oc.show_headers &&
+       !header_output && !oc.enable_cookies && oc.max_per_host == 0)
+    {
+        if(co_await segmented_download(
+               oc,
+               ssl_ctx,
+               proto_ctx,
+               conn_pool,
+               dns,
+               progress,
+               request,
+               url,
+               output_path))
+            co_return http_proto::status::ok;
+    }
+
     auto output     = any_ostream{ output_path, !!oc.resume_from };
-    auto request    = create_request(oc, msg, url);
     auto scope_fail = scope::make_scope_fail(
         [&]
         {
@@ -442,14 +791,29 @@ perform_request(
 
         co_await asio::co_spawn(
             executor,
-            connect(oc, ssl_ctx, proto_ctx, stream, url),
+            connect(oc, ssl_ctx, proto_ctx, dns, stream, url),
             asio::cancel_after(oc.connect_timeout));
 
-        if(oc.recvpersecond)
-            stream.read_limit(oc.recvpersecond.value());
+        stream.read_limit(oc.recv_limiter);
+        stream.write_limit(oc.send_limiter);
+    };
 
-        if(oc.sendpersecond)
-            stream.write_limit(oc.sendpersecond.value());
+    // Use an idle connection to the origin if there is one
+    auto reused   = false;
+    auto checkout = [&](any_stream& stream,
+                        const urls::url_view& url) -> asio::awaitable<void>
+    {
+        reused = false;
+        if(auto idle = conn_pool.acquire(oc, ssl_ctx, url))
+        {
+            if(oc.proxy.empty())
+                co_await stream.async_shutdown(asio::cancel_after(
+                    ch::milliseconds{ 500 }, asio::as_tuple));
+            stream = std::move(idle.value());
+            reused = true;
+            co_return;
+        }
+        co_await connect_to(stream, url);
     };
 
     auto stream_headers = [&](http_proto::response_view response)
@@ -484,7 +848,7 @@ perform_request(
             cookie_jar->add(url, parse_cookie(sv).value());
     };
 
-    co_await connect_to(stream, url);
+    co_await checkout(stream, url);
     parser.reset();
 
     auto org_url   = url;
@@ -494,14 +858,36 @@ perform_request(
     for(;;)
     {
         set_cookies(url, trusted);
-        msg.start_serializer(serializer, request);
 
-        if(request.method() == http_proto::method::head)
-            parser.start_head_response();
-        else
-            parser.start();
+        for(;;)
+        {
+            auto reader = msg.start_serializer(executor, serializer, request);
 
-        co_await async_request(stream, serializer, parser, oc.expect100timeout);
+            if(request.method() == http_proto::method::head)
+                parser.start_head_response();
+            else
+                parser.start();
+
+            auto [ec] = co_await async_request(
+                stream,
+                serializer,
+                parser,
+                reader.get(),
+                oc.expect100timeout,
+                asio::as_tuple);
+            if(!ec)
+                break;
+
+            // The server may have closed a pooled connection
+            // while it was idle, retry once on a new one.
+            if(!std::exchange(reused, false) || !msg.is_replayable() ||
+               !is_stale_connection_error(
+                   request.method(), ec, parser.got_header()))
+                throw system_error{ ec };
+
+            co_await connect_to(stream, url);
+            parser.reset();
+        }
 
         extract_cookies(url);
         stream_headers(parser.get());
@@ -536,7 +922,7 @@ perform_request(
         else
         {
         reconnect:
-            co_await connect_to(stream, url);
+            co_await checkout(stream, url);
             parser.reset();
         }
 
@@ -606,7 +992,10 @@ perform_request(
 
     if(!ignorebody(oc, parser.get()))
     {
-        auto pm = progress_meter{ body_size(parser.get()) };
+        auto size = body_size(parser.get());
+        auto pm   = progress_meter{ size, progress, progress_name(url) };
+        if(size)
+            output.reserve(size.value());
         parser.set_body<sink>(&pm, &output, oc.terminal_binary_ok);
 
         if(output.is_tty() || oc.parallel_max > 1 || oc.noprogress)
@@ -624,10 +1013,19 @@ perform_request(
             if(ec)
                 throw system_error{ ec };
         }
+
+        // Files are written in the background, wait for
+        // the rest of the body to reach the disk
+        output.close();
+        if(!static_cast<std::ostream&>(output))
+            throw std::runtime_error{ "Failure writing output to destination" };
     }
 
-    // clean shutdown
-    if(oc.proxy.empty())
+    // Keep the connection for later transfers to
+    // the same origin, or shut it down cleanly
+    if(parser.is_complete() && can_reuse_connection(parser.get(), url, url))
+        conn_pool.release(oc, ssl_ctx, url, std::move(stream));
+    else if(oc.proxy.empty())
         co_await stream.async_shutdown(
             asio::cancel_after(ch::milliseconds{ 500 }, asio::as_tuple));
 
@@ -733,8 +1131,16 @@ co_main(int argc, char* argv[])
     auto [oc, ssl_ctx, ropt_gen] = parse_args(argc, argv);
 
     auto executor      = co_await asio::this_coro::executor;
-    auto task_group    = ::task_group{ executor, oc.parallel_max };
+    auto task_group    = ::task_group{ executor,
+                                    oc.parallel_max,
+                                    oc.max_per_host ? oc.max_per_host
+                                                    : oc.parallel_max,
+                                    oc.parallel_max * 4u };
     auto proto_ctx     = http_proto::context{};
+    auto tls_sessions  = tls_session_cache{ ssl_ctx };
+    auto conn_pool     = connection_pool{};
+    auto dns           = dns_cache{};
+    auto progress      = std::make_shared<progress_aggregator>();
     auto cookie_jar    = boost::optional<::cookie_jar>{};
     auto header_output = boost::optional<any_ostream>{};
     auto exp_cookies   = std::string{};
@@ -773,17 +1179,33 @@ co_main(int argc, char* argv[])
     for(auto& path : oc.cookiefiles)
     {
         if(fs::exists(path))
-            any_istream{ path } >> cookie_jar.value();
+            cookie_jar->load(path);
     }
 
     if(cookie_jar && oc.cookiesession)
         cookie_jar->clear_session_cookies();
 
+    // Parallel transfers share one dashboard
+    if(oc.parallel_max > 1 && !oc.noprogress)
+    {
+        progress->set_waiting([&] { return task_group.queued(); });
+        progress->start(executor);
+    }
+
     std::exception_ptr ep;
     try
     {
         while(auto ropt = ropt_gen())
         {
+            // Transfers to one origin share its limit
+            auto origin = std::string{};
+            if(auto rs = normalize_and_parse_url(ropt->url); rs.has_value())
+            {
+                origin = rs->scheme();
+                origin.append("://");
+                origin.append(rs->encoded_host_and_port());
+            }
+
             auto request_task = [&, ropt = std::move(ropt)]()
             {
                 return perform_request(
@@ -793,22 +1215,33 @@ co_main(int argc, char* argv[])
                     exp_cookies,
                     ssl_ctx,
                     proto_ctx,
+                    conn_pool,
+                    dns,
+                    *progress,
                     oc.msg,
                     ropt.value());
             };
 
-            co_spawn(
-                executor,
-                retry(oc, std::move(request_task)),
-                co_await task_group.async_adapt(
-                    [&](auto ep)
+            co_await task_group.async_submit(
+                origin,
+                [&](auto ep)
+                {
+                    progress->task_finished();
+                    if(ep && oc.failearly)
                     {
-                        if(ep && oc.failearly)
-                        {
-                            task_group.close();
-                            task_group.emit(asio::cancellation_type::terminal);
-                        }
-                    }));
+                        task_group.close();
+                        task_group.emit(asio::cancellation_type::terminal);
+                    }
+                },
+                [&, request_task = std::move(request_task)](
+                    auto handler) mutable
+                {
+                    progress->task_started();
+                    co_spawn(
+                        executor,
+                        retry(oc, std::move(request_task)),
+                        std::move(handler));
+                });
         }
     }
     catch(const system_error& e)
@@ -823,14 +1256,22 @@ co_main(int argc, char* argv[])
 
     if(auto cs = co_await asio::this_coro::cancellation_state; !!cs.cancelled())
     {
+        task_group.close();
         task_group.emit(cs.cancelled());
         cs.clear();
     }
 
     co_await task_group.async_join();
 
+    progress->stop();
+
     if(cookie_jar && !oc.cookiejar.empty())
-        any_ostream{ oc.cookiejar } << cookie_jar.value();
+    {
+        if(oc.cookiejar == "-")
+            any_ostream{ oc.cookiejar } << cookie_jar.value();
+        else
+            cookie_jar->save(oc.cookiejar);
+    }
 
     if(ep)
         std::rethrow_exception(ep);
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "mapped_file.hpp"
+#include "error.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const fs::path& path)
+{
+    auto file = ::CreateFileW(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        throw_last_error("CreateFileW");
+
+    auto size = LARGE_INTEGER{};
+    if(!::GetFileSizeEx(file, &size))
+        close_and_throw(file, "GetFileSizeEx");
+
+    // Empty files can't be mapped
+    if(size.QuadPart == 0)
+    {
+        ::CloseHandle(file);
+        return;
+    }
+
+    auto mapping =
+        ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mapping)
+        close_and_throw(file, "CreateFileMappingW");
+    ::CloseHandle(file);
+
+    auto* p = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!p)
+        close_and_throw(mapping, "MapViewOfFile");
+    ::CloseHandle(mapping);
+
+    data_ = static_cast<const char*>(p);
+    size_ = static_cast<std::size_t>(size.QuadPart);
+}
+
+mapped_file::~mapped_file()
+{
+    if(data_)
+        ::UnmapViewOfFile(data_);
+}
+
+#else
+
+mapped_file::mapped_file(const fs::path& path)
+{
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        throw_last_error("open");
+
+    struct stat st;
+    if(::fstat(fd, &st) != 0)
+        close_and_throw(fd, "fstat");
+
+    // Empty files can't be mapped
+    if(st.st_size == 0)
+    {
+        ::close(fd);
+        return;
+    }
+
+    auto size = static_cast<std::size_t>(st.st_size);
+    auto* p   = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED)
+        close_and_throw(fd, "mmap");
+    ::close(fd);
+
+    // The file is read once, front to back
+    ::madvise(p, size, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const char*>(p);
+    size_ = size;
+}
+
+mapped_file::~mapped_file()
+{
+    if(data_)
+        ::munmap(const_cast<char*>(data_), size_);
+}
+
+#endif
@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_MAPPED_FILE_HPP
+#define BURL_MAPPED_FILE_HPP
+
+#include <boost/core/detail/string_view.hpp>
+
+#include <cstddef>
+#include <filesystem>
+
+namespace core = boost::core;
+namespace fs   = std::filesystem;
+
+/** A read-only memory mapping of a whole file
+
+    The contents are paged in on demand and never
+    copied, however large the file is.
+*/
+class mapped_file
+{
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+
+public:
+    /** Map a file
+
+        @throws boost::system::system_error
+    */
+    explicit mapped_file(const fs::path& path);
+
+    mapped_file(const mapped_file&) = delete;
+
+    mapped_file&
+    operator=(const mapped_file&) = delete;
+
+    ~mapped_file();
+
+    core::string_view
+    view() const noexcept
+    {
+        return { data_, size_ };
+    }
+};
+
+#endif
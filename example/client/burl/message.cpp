@@ -10,15 +10,119 @@
 #include "message.hpp"
 #include "mime_type.hpp"
 
+#include <boost/asio/append.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/http_proto/field.hpp>
 #include <boost/system/system_error.hpp>
 
 #include <filesystem>
 #include <iostream>
 
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace fs       = std::filesystem;
 using system_error = boost::system::system_error;
 
+namespace
+{
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+class stdin_reader : public body_reader
+{
+    asio::posix::stream_descriptor sd_;
+    http_proto::serializer::stream body_;
+    int flags_;
+
+public:
+    stdin_reader(
+        const asio::any_io_executor& executor,
+        http_proto::serializer::stream body)
+        : sd_{ executor }
+        , body_{ std::move(body) }
+    {
+        // A duplicate keeps the real stdin open when the
+        // descriptor is closed, but it shares the file
+        // status flags, which asio makes non-blocking.
+        auto fd = ::dup(STDIN_FILENO);
+        if(fd == -1)
+            throw system_error{ error_code{ errno,
+                                            boost::system::system_category() },
+                                "dup" };
+        flags_ = ::fcntl(fd, F_GETFL);
+        sd_.assign(fd);
+    }
+
+    ~stdin_reader()
+    {
+        if(flags_ != -1)
+            ::fcntl(sd_.native_handle(), F_SETFL, flags_);
+    }
+
+    void
+    async_fill(asio::any_completion_handler<void(error_code)> handler) override
+    {
+        asio::async_compose<decltype(handler), void(error_code)>(
+            [this, started = false](
+                auto&& self, error_code ec = {}, std::size_t n = 0) mutable
+            {
+                if(!std::exchange(started, true))
+                    return sd_.async_read_some(
+                        body_.prepare(), std::move(self));
+
+                body_.commit(n);
+                if(ec == asio::error::eof)
+                {
+                    body_.close();
+                    ec = {};
+                }
+                self.complete(ec);
+            },
+            handler,
+            sd_);
+    }
+};
+#else
+// Without a way to wait for the console or a pipe,
+// stdin is read synchronously.
+class stdin_reader : public body_reader
+{
+    asio::any_io_executor executor_;
+    http_proto::serializer::stream body_;
+
+public:
+    stdin_reader(
+        const asio::any_io_executor& executor,
+        http_proto::serializer::stream body)
+        : executor_{ executor }
+        , body_{ std::move(body) }
+    {
+    }
+
+    void
+    async_fill(asio::any_completion_handler<void(error_code)> handler) override
+    {
+        auto mb = buffers::mutable_buffer{ *body_.prepare().begin() };
+        std::cin.read(static_cast<char*>(mb.data()), mb.size());
+        body_.commit(static_cast<std::size_t>(std::cin.gcount()));
+
+        auto ec = error_code{};
+        if(std::cin.eof())
+            body_.close();
+        else if(std::cin.bad())
+            ec = boost::system::errc::make_error_code(
+                boost::system::errc::io_error);
+
+        asio::post(executor_, asio::append(std::move(handler), ec));
+    }
+};
+#endif
+} // namespace
+
 string_body::string_body(std::string body, std::string content_type)
     : body_{ std::move(body) }
     , content_type_{ std::move(content_type) }
@@ -88,16 +192,6 @@ file_body::body() const
 
 // -----------------------------------------------------------------------------
 
-boost::http_proto::source::results
-stdin_body::source::on_read(buffers::mutable_buffer mb)
-{
-    std::cin.read(static_cast<char*>(mb.data()), mb.size());
-
-    return { .ec       = {},
-             .bytes    = static_cast<std::size_t>(std::cin.gcount()),
-             .finished = std::cin.eof() };
-}
-
 http_proto::method
 stdin_body::method() const
 {
@@ -116,10 +210,12 @@ stdin_body::content_length() const
     return boost::none;
 }
 
-stdin_body::source
-stdin_body::body() const
+std::unique_ptr<body_reader>
+stdin_body::body(
+    const asio::any_io_executor& executor,
+    http_proto::serializer::stream stream) const
 {
-    return {};
+    return std::make_unique<stdin_reader>(executor, std::move(stream));
 }
 
 // -----------------------------------------------------------------------------
@@ -155,15 +251,22 @@ message::set_headers(http_proto::request& request) const
         body_);
 }
 
-void
+std::unique_ptr<body_reader>
 message::start_serializer(
+    const asio::any_io_executor& executor,
     http_proto::serializer& serializer,
     http_proto::request& request) const
 {
-    std::visit(
-        [&](auto& f)
+    return std::visit(
+        [&](auto& f) -> std::unique_ptr<body_reader>
         {
-            if constexpr(!std::is_same_v<decltype(f), const std::monostate&>)
+            if constexpr(std::is_same_v<decltype(f), const stdin_body&>)
+            {
+                return f.body(executor, serializer.start_stream(request));
+            }
+            else if constexpr(!std::is_same_v<
+                                  decltype(f),
+                                  const std::monostate&>)
             {
                 serializer.start<std::decay_t<decltype(f.body())>>(
                     request, f.body());
@@ -172,6 +275,7 @@ message::start_serializer(
             {
                 serializer.start(request);
             }
+            return nullptr;
         },
         body_);
 }
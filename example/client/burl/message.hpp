@@ -11,11 +11,14 @@
 #define BURL_MESSAGE_HPP
 
 #include "multipart_form.hpp"
+#include "request.hpp"
 
+#include <boost/asio/any_io_executor.hpp>
 #include <boost/http_proto/file_body.hpp>
 #include <boost/http_proto/request.hpp>
 #include <boost/http_proto/serializer.hpp>
 
+#include <memory>
 #include <variant>
 
 namespace core = boost::core;
@@ -64,13 +67,6 @@ public:
 class stdin_body
 {
 public:
-    class source : public http_proto::source
-    {
-    public:
-        results
-        on_read(buffers::mutable_buffer mb) override;
-    };
-
     http_proto::method
     method() const;
 
@@ -80,8 +76,16 @@ public:
     boost::optional<std::size_t>
     content_length() const;
 
-    source
-    body() const;
+    /** Return a reader that streams standard input
+
+        Reads don't block the executor, so a slow
+        producer on the other end of a pipe doesn't hold
+        up the other transfers.
+    */
+    std::unique_ptr<body_reader>
+    body(
+        const asio::any_io_executor& executor,
+        http_proto::serializer::stream stream) const;
 };
 
 class message
@@ -108,8 +112,22 @@ public:
     void
     set_headers(http_proto::request& request) const;
 
-    void
+    // Return true if the body can be sent again
+    bool
+    is_replayable() const noexcept
+    {
+        return !std::holds_alternative<stdin_body>(body_);
+    }
+
+    /** Start the serializer with the body
+
+        @return The reader that fills a streamed body
+        while the request is written, or null if the
+        serializer has the whole body at hand.
+    */
+    std::unique_ptr<body_reader>
     start_serializer(
+        const asio::any_io_executor& executor,
         http_proto::serializer& serializer,
         http_proto::request& request) const;
 };
@@ -8,10 +8,10 @@
 //
 
 #include "multipart_form.hpp"
+#include "sequential_file.hpp"
 
 #include <boost/buffers/algorithm.hpp>
 #include <boost/buffers/buffer_copy.hpp>
-#include <boost/http_proto/file.hpp>
 #include <boost/system/system_error.hpp>
 
 #include <filesystem>
@@ -146,6 +146,10 @@ multipart_form::source::source(const multipart_form* form) noexcept
 {
 }
 
+multipart_form::source::source(source&&) noexcept = default;
+
+multipart_form::source::~source() = default;
+
 multipart_form::source::results
 multipart_form::source::on_read(buffers::mutable_buffer mb)
 {
@@ -172,31 +176,48 @@ multipart_form::source::on_read(buffers::mutable_buffer mb)
 
     auto read = [&](const std::string& path, uint64_t size)
     {
-        http_proto::file file;
-
-        file.open(path.c_str(), http_proto::file_mode::read, rs.ec);
-        if(rs.ec)
-            return false;
-
-        file.seek(skip_, rs.ec);
-        if(rs.ec)
-            return false;
-
-        auto read = file.read(
-            mb.data(),
-            (std::min)(static_cast<std::uint64_t>(mb.size()), size),
-            rs.ec);
-        if(rs.ec)
-            return false;
-
-        mb        = buffers::sans_prefix(mb, read);
-        rs.bytes += read;
-        skip_    += read;
+        // The file stays open until the part is sent, so
+        // each call is a single pread rather than an open,
+        // a seek and a read.
+        try
+        {
+            if(!file_)
+                file_ = std::make_unique<sequential_file>(path);
 
-        if(skip_ != size)
+            while(skip_ != size)
+            {
+                if(mb.size() == 0)
+                    return false;
+
+                auto n = file_->read_at(
+                    skip_,
+                    buffers::prefix(
+                        mb,
+                        static_cast<std::size_t>((std::min)(
+                            static_cast<std::uint64_t>(mb.size()),
+                            size - skip_))));
+
+                // The file shrank since its size was taken
+                if(n == 0)
+                {
+                    rs.ec = boost::system::errc::make_error_code(
+                        boost::system::errc::io_error);
+                    return false;
+                }
+
+                mb        = buffers::sans_prefix(mb, n);
+                rs.bytes += n;
+                skip_    += n;
+            }
+        }
+        catch(const system_error& e)
+        {
+            rs.ec = e.code();
             return false;
+        }
 
         skip_ = 0;
+        file_.reset();
         return true;
     };
 
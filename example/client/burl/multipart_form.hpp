@@ -18,12 +18,15 @@
 #include <boost/system/error_code.hpp>
 
 #include <array>
+#include <memory>
 #include <vector>
 
 namespace buffers    = boost::buffers;
 namespace http_proto = boost::http_proto;
 using error_code     = boost::system::error_code;
 
+class sequential_file;
+
 class multipart_form
 {
     struct part
@@ -75,9 +78,16 @@ class multipart_form::source : public http_proto::source
     int step_           = 0;
     std::uint64_t skip_ = 0;
 
+    // The file part being sent, open across reads
+    std::unique_ptr<sequential_file> file_;
+
 public:
     explicit source(const multipart_form* form) noexcept;
 
+    source(source&&) noexcept;
+
+    ~source();
+
     results
     on_read(buffers::mutable_buffer mb) override;
 };
@@ -356,6 +356,9 @@ parse_args(int argc, char* argv[])
         ("parallel-max",
             po::value<std::uint16_t>()->value_name("<num>"),
             "Maximum concurrency for parallel transfers")
+        ("parallel-max-host",
+            po::value<std::uint16_t>()->value_name("<num>"),
+            "Maximum concurrent transfers per host (with --parallel)")
         ("pass",
             po::value<std::string>()->value_name("<phrase>"),
             "Passphrase for the private key")
@@ -400,6 +403,11 @@ parse_args(int argc, char* argv[])
         ("retry-max-time",
             po::value<double>()->value_name("<frac sec>"),
             "Retry only within this period")
+        ("segments",
+            po::value<std::uint16_t>()->value_name("<num>"),
+            "Download a single resource over parallel range requests, "
+            "unless headers are shown or saved, cookies are enabled "
+            "or --parallel-max-host is set")
         ("show-headers", "Show response headers in the output")
         ("skip-existing", "Skip download if local file already exists")
         ("tcp-nodelay", "Use the TCP_NODELAY option")
@@ -565,8 +573,10 @@ parse_args(int argc, char* argv[])
             parse_human_readable_size(vm.at("limit-rate").as<std::string>());
         if(limit.has_error())
             throw std::runtime_error{ "unsupported limit-rate unit" };
-        oc.recvpersecond = limit.value();
-        oc.sendpersecond = limit.value();
+        // shared by all transfers, so parallel ones
+        // don't multiply the rate
+        oc.recv_limiter = std::make_shared<rate_limiter>(limit.value());
+        oc.send_limiter = std::make_shared<rate_limiter>(limit.value());
     }
 
     if(vm.contains("max-redirs"))
@@ -595,6 +605,17 @@ parse_args(int argc, char* argv[])
             if(value > 0 && value <= 300)
                 oc.parallel_max = value;
         }
+
+        if(vm.contains("parallel-max-host"))
+            oc.max_per_host = vm.at("parallel-max-host").as<std::uint16_t>();
+    }
+
+    if(vm.contains("segments"))
+    {
+        auto value = vm.at("segments").as<std::uint16_t>();
+        if(value == 0 || value > 64)
+            throw std::runtime_error("--segments must be between 1 and 64");
+        oc.segments = value;
     }
 
     if(vm.contains("proto-redir"))
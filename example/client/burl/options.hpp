@@ -11,6 +11,7 @@
 #define BURL_OPTIONS_HPP
 
 #include "message.hpp"
+#include "rate_limiter.hpp"
 
 #include <boost/asio/ssl/context.hpp>
 #include <boost/http_proto/fields.hpp>
@@ -20,6 +21,7 @@
 #include <chrono>
 #include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -39,8 +41,8 @@ struct operation_config
     boost::optional<duration_type> retry_delay;
     boost::optional<duration_type> retry_maxtime;
     bool disallow_username_in_url = false;
-    boost::optional<std::size_t> recvpersecond;
-    boost::optional<std::size_t> sendpersecond;
+    std::shared_ptr<rate_limiter> recv_limiter;
+    std::shared_ptr<rate_limiter> send_limiter;
     bool encoding              = false;
     bool create_dirs           = false;
     std::uint64_t maxredirs    = 50;
@@ -48,6 +50,8 @@ struct operation_config
     bool tcp_nodelay           = true;
     std::uint64_t req_retry    = 0;
     std::uint16_t parallel_max = 1;
+    std::uint16_t max_per_host = 0;
+    std::uint16_t segments     = 1;
     bool retry_connrefused     = false;
     bool retry_all_errors      = false;
     bool nokeepalive           = false;
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "positional_file.hpp"
+#include "error.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+positional_file::positional_file(const fs::path& path, std::uint64_t size)
+{
+    auto h = ::CreateFileW(
+        path.c_str(),
+        GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if(h == INVALID_HANDLE_VALUE)
+        throw_last_error("CreateFileW");
+    handle_ = h;
+
+    auto end     = LARGE_INTEGER{};
+    end.QuadPart = static_cast<LONGLONG>(size);
+    if(!::SetFilePointerEx(h, end, nullptr, FILE_BEGIN) || !::SetEndOfFile(h))
+        close_and_throw(h, "SetEndOfFile");
+}
+
+positional_file::~positional_file()
+{
+    ::CloseHandle(static_cast<HANDLE>(handle_));
+}
+
+void
+positional_file::write_at(std::uint64_t offset, buffers::const_buffer cb)
+{
+    auto p = static_cast<const char*>(cb.data());
+    auto n = cb.size();
+    while(n != 0)
+    {
+        auto ov       = OVERLAPPED{};
+        ov.Offset     = static_cast<DWORD>(offset);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        auto chunk   = static_cast<DWORD>(n > 0x40000000 ? 0x40000000 : n);
+        auto written = DWORD{};
+        if(!::WriteFile(
+               static_cast<HANDLE>(handle_), p, chunk, &written, &ov))
+            throw_last_error("WriteFile");
+
+        p      += written;
+        n      -= written;
+        offset += written;
+    }
+}
+
+#else
+
+positional_file::positional_file(const fs::path& path, std::uint64_t size)
+{
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd_ == -1)
+        throw_last_error("open");
+
+    // Reserve the blocks up front so the regions don't
+    // fragment as they are filled in parallel. Some file
+    // systems can't, a sparse file will do.
+#ifdef __linux__
+    if(::posix_fallocate(fd_, 0, static_cast<off_t>(size)) == 0)
+        return;
+#endif
+    if(::ftruncate(fd_, static_cast<off_t>(size)) != 0)
+        close_and_throw(fd_, "ftruncate");
+}
+
+positional_file::~positional_file()
+{
+    ::close(fd_);
+}
+
+void
+positional_file::write_at(std::uint64_t offset, buffers::const_buffer cb)
+{
+    auto p = static_cast<const char*>(cb.data());
+    auto n = cb.size();
+    while(n != 0)
+    {
+        auto rv = ::pwrite(fd_, p, n, static_cast<off_t>(offset));
+        if(rv < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw_last_error("pwrite");
+        }
+        p      += rv;
+        n      -= static_cast<std::size_t>(rv);
+        offset += static_cast<std::uint64_t>(rv);
+    }
+}
+
+#endif
@@ -0,0 +1,57 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_POSITIONAL_FILE_HPP
+#define BURL_POSITIONAL_FILE_HPP
+
+#include <boost/buffers/const_buffer.hpp>
+
+#include <cstdint>
+#include <filesystem>
+
+namespace buffers = boost::buffers;
+namespace fs      = std::filesystem;
+
+/** A file written at explicit offsets
+
+    Several writers may fill disjoint regions of the
+    file in any order, without seeking or sharing a
+    file position.
+*/
+class positional_file
+{
+#ifdef _WIN32
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+
+public:
+    /** Create or truncate a file and reserve its size
+
+        @throws boost::system::system_error
+    */
+    positional_file(const fs::path& path, std::uint64_t size);
+
+    positional_file(const positional_file&) = delete;
+
+    positional_file&
+    operator=(const positional_file&) = delete;
+
+    ~positional_file();
+
+    /** Write all of a buffer at an offset
+
+        @throws boost::system::system_error
+    */
+    void
+    write_at(std::uint64_t offset, buffers::const_buffer cb);
+};
+
+#endif
@@ -0,0 +1,183 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "progress_aggregator.hpp"
+#include "utils.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+using error_code = boost::system::error_code;
+
+namespace
+{
+// Weight of the newest sample in the smoothed rates
+constexpr double rate_smoothing = 0.3;
+
+// Active transfers listed below the summary
+constexpr std::size_t max_listed = 8;
+} // namespace
+
+progress_aggregator::progress_aggregator(ch::steady_clock::duration interval)
+    : interval_{ interval }
+{
+}
+
+void
+progress_aggregator::set_waiting(std::function<std::size_t()> f)
+{
+    waiting_ = std::move(f);
+}
+
+void
+progress_aggregator::task_started() noexcept
+{
+    tasks_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+progress_aggregator::task_finished() noexcept
+{
+    tasks_.fetch_sub(1, std::memory_order_relaxed);
+    done_.fetch_add(1, std::memory_order_relaxed);
+}
+
+progress_aggregator::handle
+progress_aggregator::add(
+    std::string name,
+    boost::optional<std::uint64_t> total)
+{
+    return transfers_.emplace(transfers_.end(), std::move(name), total);
+}
+
+void
+progress_aggregator::remove(handle h) noexcept
+{
+    transfers_.erase(h);
+}
+
+void
+progress_aggregator::start(asio::any_io_executor executor)
+{
+    timer_.emplace(std::move(executor));
+    sampled_at_ = ch::steady_clock::now();
+    schedule();
+}
+
+void
+progress_aggregator::stop()
+{
+    if(!timer_)
+        return;
+
+    timer_.reset();
+    sample();
+    render();
+    std::cerr << '\n' << std::flush;
+}
+
+void
+progress_aggregator::schedule()
+{
+    timer_->expires_after(interval_);
+    timer_->async_wait(
+        [weak = weak_from_this()](error_code ec)
+        {
+            auto self = weak.lock();
+            if(!self || ec || !self->timer_)
+                return;
+
+            self->sample();
+            self->render();
+            self->schedule();
+        });
+}
+
+void
+progress_aggregator::sample()
+{
+    // Timer expiries can be late, measure the time
+    // which actually passed since the last sample
+    auto at      = ch::steady_clock::now();
+    auto seconds = ch::duration<double>{ at - sampled_at_ }.count();
+    if(seconds <= 0)
+        return;
+    sampled_at_ = at;
+
+    auto smooth = [&](double& rate, std::uint64_t& sampled, std::uint64_t now)
+    {
+        auto cur = static_cast<double>(now - sampled) / seconds;
+        rate     = rate_smoothing * cur + (1 - rate_smoothing) * rate;
+        sampled  = now;
+    };
+
+    smooth(rate_, sampled_, bytes_.load(std::memory_order_relaxed));
+    for(auto& t : transfers_)
+        smooth(t.rate, t.sampled, t.bytes.load(std::memory_order_relaxed));
+}
+
+void
+progress_aggregator::render()
+{
+    auto active    = transfers_.size();
+    auto tasks     = tasks_.load(std::memory_order_relaxed);
+    auto queued    = std::size_t{ tasks > active ? tasks - active : 0 };
+    if(waiting_)
+        queued += waiting_();
+    auto remaining = std::uint64_t{};
+    auto known     = true;
+    for(const auto& t : transfers_)
+    {
+        auto bytes = t.bytes.load(std::memory_order_relaxed);
+        if(t.total && t.total.value() >= bytes)
+            remaining += t.total.value() - bytes;
+        else
+            known = false;
+    }
+
+    // Redraw over the previous frame
+    if(lines_ > 1)
+        std::cerr << "\x1b[" << (lines_ - 1) << 'F';
+    std::cerr << "\r\x1b[J";
+
+    std::cerr << active << " active, " << queued << " queued, "
+              << done_.load(std::memory_order_relaxed) << " done | "
+              << std::setw(7)
+              << format_size(bytes_.load(std::memory_order_relaxed))
+              << " | " << std::setw(7)
+              << format_size(static_cast<std::uint64_t>(rate_)) << "/s | ";
+
+    auto rate = static_cast<std::uint64_t>(rate_);
+    if(known && rate != 0 && remaining / rate <= 99 * 3600)
+        std::cerr << ch::hh_mm_ss<ch::seconds>{ ch::seconds{ remaining /
+                                                             rate } };
+    else
+        std::cerr << "--:--:--";
+
+    auto lines = std::size_t{ 1 };
+    for(const auto& t : transfers_)
+    {
+        if(lines > max_listed)
+            break;
+
+        auto bytes = t.bytes.load(std::memory_order_relaxed);
+        std::cerr << "\n  " << std::setw(7) << format_size(bytes);
+        if(t.total && t.total.value() != 0)
+            std::cerr << std::setw(4) << bytes * 100 / t.total.value() << '%';
+        else
+            std::cerr << "    ?";
+        std::cerr << " | " << std::setw(7)
+                  << format_size(static_cast<std::uint64_t>(t.rate))
+                  << "/s | " << t.name;
+        ++lines;
+    }
+
+    std::cerr << std::flush;
+    lines_ = lines;
+}
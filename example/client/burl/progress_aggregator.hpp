@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_PROGRESS_AGGREGATOR_HPP
+#define BURL_PROGRESS_AGGREGATOR_HPP
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/optional/optional.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+
+namespace asio = boost::asio;
+namespace ch   = std::chrono;
+
+/** Combined progress of all the transfers of a run
+
+    Transfers add their bytes with relaxed atomic
+    increments, and a single timer samples the counters
+    and redraws a dashboard on stderr: the totals, the
+    aggregate rate and ETA, and one line per active
+    transfer with its own rate.
+
+    A task is queued while it waits for a slot, and
+    from the time it is started until its response
+    body begins. It is active while the body is
+    received.
+*/
+class progress_aggregator
+    : public std::enable_shared_from_this<progress_aggregator>
+{
+    struct transfer
+    {
+        std::string name;
+        boost::optional<std::uint64_t> total;
+        std::atomic<std::uint64_t> bytes = 0;
+
+        // sampled by the renderer
+        std::uint64_t sampled = 0;
+        double rate           = 0;
+
+        transfer(std::string name, boost::optional<std::uint64_t> total)
+            : name{ std::move(name) }
+            , total{ total }
+        {
+        }
+    };
+
+    std::list<transfer> transfers_;
+    std::atomic<std::uint64_t> bytes_ = 0;
+    std::atomic<std::uint32_t> tasks_ = 0;
+    std::atomic<std::uint32_t> done_  = 0;
+    std::function<std::size_t()> waiting_;
+    std::uint64_t sampled_            = 0;
+    double rate_                      = 0;
+    ch::steady_clock::time_point sampled_at_;
+    ch::steady_clock::duration interval_;
+    boost::optional<asio::steady_timer> timer_;
+    std::size_t lines_ = 0;
+
+public:
+    using handle = std::list<transfer>::iterator;
+
+    explicit progress_aggregator(
+        ch::steady_clock::duration interval = ch::milliseconds{ 250 });
+
+    /** Set a function counting the tasks waiting for a slot
+
+        It is called on the executor passed to @ref start.
+    */
+    void
+    set_waiting(std::function<std::size_t()> f);
+
+    void
+    task_started() noexcept;
+
+    void
+    task_finished() noexcept;
+
+    /// Register a transfer whose body has begun
+    handle
+    add(std::string name, boost::optional<std::uint64_t> total);
+
+    void
+    remove(handle h) noexcept;
+
+    void
+    update(handle h, std::uint64_t bytes) noexcept
+    {
+        h->bytes.fetch_add(bytes, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    /// Start redrawing the dashboard periodically
+    void
+    start(asio::any_io_executor executor);
+
+    /// Stop redrawing, after drawing the final state
+    void
+    stop();
+
+private:
+    void
+    schedule();
+
+    void
+    sample();
+
+    void
+    render();
+};
+
+#endif
@@ -16,6 +16,22 @@ progress_meter::progress_meter(boost::optional<std::uint64_t> total)
 {
 }
 
+progress_meter::progress_meter(
+    boost::optional<std::uint64_t> total,
+    progress_aggregator& aggregator,
+    std::string name)
+    : total_{ total }
+    , aggregator_{ &aggregator }
+    , handle_{ aggregator.add(std::move(name), total) }
+{
+}
+
+progress_meter::~progress_meter()
+{
+    if(aggregator_)
+        aggregator_->remove(handle_);
+}
+
 void
 progress_meter::update(std::uint64_t bytes) noexcept
 {
@@ -35,6 +51,9 @@ progress_meter::update(std::uint64_t bytes) noexcept
 
     transfered_    += bytes;
     window_.back() += bytes;
+
+    if(aggregator_)
+        aggregator_->update(handle_, bytes);
 }
 
 std::uint64_t
@@ -10,12 +10,15 @@
 #ifndef BURL_PROGRESS_METER_HPP
 #define BURL_PROGRESS_METER_HPP
 
+#include "progress_aggregator.hpp"
+
 #include <boost/core/detail/string_view.hpp>
 #include <boost/optional/optional.hpp>
 
 #include <array>
 #include <chrono>
 #include <cstdint>
+#include <string>
 
 namespace ch = std::chrono;
 
@@ -26,10 +29,29 @@ class progress_meter
     std::array<std::uint64_t, 5> window_      = {};
     ch::steady_clock::time_point init_        = ch::steady_clock::now();
     ch::steady_clock::time_point last_update_ = ch::steady_clock::now();
+    progress_aggregator* aggregator_          = nullptr;
+    progress_aggregator::handle handle_;
 
 public:
     progress_meter(boost::optional<std::uint64_t> total);
 
+    /** Construct a meter that also reports to an aggregator
+
+        The transfer is listed under the given name until
+        the meter is destroyed.
+    */
+    progress_meter(
+        boost::optional<std::uint64_t> total,
+        progress_aggregator& aggregator,
+        std::string name);
+
+    progress_meter(const progress_meter&) = delete;
+
+    progress_meter&
+    operator=(const progress_meter&) = delete;
+
+    ~progress_meter();
+
     void
     update(std::uint64_t bytes) noexcept;
 
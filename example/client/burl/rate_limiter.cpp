@@ -0,0 +1,122 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "rate_limiter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using error_code = boost::system::error_code;
+
+rate_limiter::rate_limiter(
+    std::size_t bytes_per_second,
+    ch::steady_clock::duration interval)
+    : rate_{ static_cast<double>(bytes_per_second) }
+    , tokens_{ 0 }
+    , last_{ ch::steady_clock::now() }
+    , interval_{ interval }
+{
+    // Allow a burst of a few refills, so streams that
+    // are woken late don't lose their share
+    capacity_ = std::max(
+        rate_ * ch::duration<double>{ interval_ * 5 }.count(), 1.0);
+}
+
+bool
+rate_limiter::acquire(waiter& w)
+{
+    refill(ch::steady_clock::now());
+
+    // Nothing to wait for, and a queued request
+    // would be woken with nothing granted
+    w.granted = 0;
+    if(w.want == 0)
+        return true;
+
+    if(waiters_.empty() && tokens_ >= 1)
+    {
+        w.granted = static_cast<std::size_t>(
+            std::min(static_cast<double>(w.want), std::floor(tokens_)));
+        tokens_ -= static_cast<double>(w.granted);
+        return true;
+    }
+
+    waiters_.push_back(&w);
+    schedule(w.timer->get_executor());
+    return false;
+}
+
+void
+rate_limiter::cancel(waiter& w) noexcept
+{
+    if(auto it = std::find(waiters_.begin(), waiters_.end(), &w);
+       it != waiters_.end())
+        waiters_.erase(it);
+}
+
+void
+rate_limiter::refund(std::size_t n) noexcept
+{
+    tokens_ = std::min(tokens_ + static_cast<double>(n), capacity_);
+}
+
+void
+rate_limiter::refill(ch::steady_clock::time_point now) noexcept
+{
+    auto elapsed = ch::duration<double>{ now - last_ }.count();
+    tokens_      = std::min(tokens_ + rate_ * elapsed, capacity_);
+    last_        = now;
+}
+
+void
+rate_limiter::distribute()
+{
+    refill(ch::steady_clock::now());
+
+    // Each waiter gets an even share of what is left,
+    // and what one doesn't want goes to the next
+    while(!waiters_.empty() && tokens_ >= 1)
+    {
+        auto share = std::max(
+            std::floor(tokens_ / static_cast<double>(waiters_.size())), 1.0);
+
+        auto* w = waiters_.front();
+        waiters_.pop_front();
+
+        w->granted = static_cast<std::size_t>(
+            std::min(static_cast<double>(w->want), share));
+        tokens_ -= static_cast<double>(w->granted);
+        w->timer->cancel();
+    }
+}
+
+void
+rate_limiter::schedule(const asio::any_io_executor& executor)
+{
+    if(scheduled_)
+        return;
+
+    if(!timer_)
+        timer_.emplace(executor);
+
+    scheduled_ = true;
+    timer_->expires_after(interval_);
+    timer_->async_wait(
+        [weak = weak_from_this()](error_code ec)
+        {
+            auto self = weak.lock();
+            if(!self || ec)
+                return;
+
+            self->scheduled_ = false;
+            self->distribute();
+            if(!self->waiters_.empty())
+                self->schedule(self->timer_->get_executor());
+        });
+}
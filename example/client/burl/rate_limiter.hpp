@@ -0,0 +1,89 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_RATE_LIMITER_HPP
+#define BURL_RATE_LIMITER_HPP
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/optional/optional.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+
+namespace asio = boost::asio;
+namespace ch   = std::chrono;
+
+/** A token bucket shared by every stream it limits
+
+    Tokens are bytes. They accumulate continuously at
+    the configured rate, up to a small burst, and are
+    handed out in the order streams asked for them.
+    When several streams wait, each refill is split
+    evenly among them, so the aggregate rate stays at
+    the limit however many transfers run in parallel.
+*/
+class rate_limiter : public std::enable_shared_from_this<rate_limiter>
+{
+public:
+    /** A request for tokens
+
+        A waiter is queued by @ref acquire and woken by
+        cancelling its timer once tokens are granted.
+    */
+    struct waiter
+    {
+        std::size_t want          = 0;
+        std::size_t granted       = 0;
+        asio::steady_timer* timer = nullptr;
+    };
+
+    explicit rate_limiter(
+        std::size_t bytes_per_second,
+        ch::steady_clock::duration interval = ch::milliseconds{ 10 });
+
+    /** Take tokens for a waiter
+
+        @return `true` if tokens were granted at once,
+        or none were wanted, `false` if the waiter was
+        queued and must wait on its timer.
+    */
+    bool
+    acquire(waiter& w);
+
+    /// Remove a waiter that stopped waiting
+    void
+    cancel(waiter& w) noexcept;
+
+    /// Return tokens that were granted but not used
+    void
+    refund(std::size_t n) noexcept;
+
+private:
+    void
+    refill(ch::steady_clock::time_point now) noexcept;
+
+    void
+    distribute();
+
+    void
+    schedule(const asio::any_io_executor& executor);
+
+    double rate_;
+    double capacity_;
+    double tokens_;
+    ch::steady_clock::time_point last_;
+    ch::steady_clock::duration interval_;
+    std::deque<waiter*> waiters_;
+    boost::optional<asio::steady_timer> timer_;
+    bool scheduled_ = false;
+};
+
+#endif
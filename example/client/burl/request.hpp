@@ -10,7 +10,10 @@
 #ifndef BURL_REQUEST_HPP
 #define BURL_REQUEST_HPP
 
+#include <boost/asio/any_completion_handler.hpp>
 #include <boost/asio/awaitable.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/coroutine.hpp>
 #include <boost/asio/deferred.hpp>
 #include <boost/asio/experimental/parallel_group.hpp>
 #include <boost/asio/steady_timer.hpp>
@@ -29,12 +32,97 @@ namespace http_io    = boost::http_io;
 namespace http_proto = boost::http_proto;
 using error_code     = boost::system::error_code;
 
+/** An asynchronous producer of a streamed request body
+
+    The serializer is started with a body stream, and
+    whenever it runs dry the reader fills it from its
+    source, closing it at the end of the input.
+*/
+class body_reader
+{
+public:
+    virtual ~body_reader() = default;
+
+    virtual void
+    async_fill(asio::any_completion_handler<void(error_code)> handler) = 0;
+};
+
+template<class AsyncWriteStream>
+class async_write_request_op
+{
+    AsyncWriteStream& stream_;
+    http_proto::serializer& serializer_;
+    body_reader* reader_;
+    std::size_t n_ = 0;
+    asio::coroutine c;
+
+public:
+    async_write_request_op(
+        AsyncWriteStream& stream,
+        http_proto::serializer& serializer,
+        body_reader* reader)
+        : stream_{ stream }
+        , serializer_{ serializer }
+        , reader_{ reader }
+    {
+    }
+
+    template<class Self>
+    void
+    operator()(Self&& self, error_code ec = {}, std::size_t n = {})
+    {
+        BOOST_ASIO_CORO_REENTER(c)
+        {
+            for(;;)
+            {
+                BOOST_ASIO_CORO_YIELD
+                http_io::async_write(stream_, serializer_, std::move(self));
+
+                n_ += n;
+                if(ec != http_proto::error::need_data || !reader_)
+                    break;
+
+                BOOST_ASIO_CORO_YIELD
+                reader_->async_fill(std::move(self));
+
+                if(ec)
+                    break;
+            }
+            self.complete(ec, n_);
+        }
+    }
+};
+
+/** Write a request, filling a streamed body as it drains
+
+    @param reader The producer of the body, or null if
+    the serializer has the whole body at hand.
+*/
+template<
+    class AsyncWriteStream,
+    typename CompletionToken = asio::default_completion_token_t<
+        typename AsyncWriteStream::executor_type>>
+auto
+async_write_request(
+    AsyncWriteStream& stream,
+    http_proto::serializer& serializer,
+    body_reader* reader,
+    CompletionToken&& token = CompletionToken{})
+{
+    return asio::
+        async_compose<CompletionToken, void(error_code, std::size_t)>(
+            async_write_request_op{ stream, serializer, reader },
+            token,
+            stream);
+}
+
 template<class AsyncReadStream>
 class async_request_op
 {
     AsyncReadStream& stream_;
     http_proto::serializer& serializer_;
     http_proto::response_parser& parser_;
+    body_reader* reader_;
     ch::steady_clock::duration exp100_timeout_;
     asio::coroutine c;
 
@@ -55,10 +143,12 @@ public:
         AsyncReadStream& stream,
         http_proto::serializer& serializer,
         http_proto::response_parser& parser,
+        body_reader* reader,
         ch::steady_clock::duration exp100_timeout)
         : stream_{ stream }
         , serializer_{ serializer }
         , parser_{ parser }
+        , reader_{ reader }
         , exp100_timeout_{ exp100_timeout }
     {
     }
@@ -75,7 +165,8 @@ public:
                 asio::enable_total_cancellation{});
 
             BOOST_ASIO_CORO_YIELD
-            http_io::async_write(stream_, serializer_, std::move(self));
+            async_write_request(
+                stream_, serializer_, reader_, std::move(self));
 
             if(!ec)
             {
@@ -99,11 +190,13 @@ public:
                     deferred(
                         [&stream     = stream_,
                          &serializer = serializer_,
+                         reader      = reader_,
                          exp100      = exp100_.get()](error_code)
                         {
                             return deferred
                                 .when(exp100->state != exp100::cancelled)
-                                .then(http_io::async_write(stream, serializer))
+                                .then(async_write_request(
+                                    stream, serializer, reader))
                                 .otherwise(deferred.values(
                                     error_code{}, std::size_t{ 0 }));
                         }),
@@ -159,11 +252,13 @@ async_request(
     AsyncReadStream& stream,
     http_proto::serializer& serializer,
     http_proto::response_parser& parser,
+    body_reader* reader,
     ch::steady_clock::duration expect100_timeout,
     CompletionToken&& token = CompletionToken{})
 {
     return asio::async_compose<CompletionToken, void(error_code)>(
-        async_request_op{ stream, serializer, parser, expect100_timeout },
+        async_request_op{
+            stream, serializer, parser, reader, expect100_timeout },
         token,
         stream);
 }
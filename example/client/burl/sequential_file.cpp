@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "sequential_file.hpp"
+#include "error.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+sequential_file::sequential_file(const fs::path& path)
+{
+    auto h = ::CreateFileW(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if(h == INVALID_HANDLE_VALUE)
+        throw_last_error("CreateFileW");
+    handle_ = h;
+}
+
+sequential_file::~sequential_file()
+{
+    ::CloseHandle(static_cast<HANDLE>(handle_));
+}
+
+std::size_t
+sequential_file::read_at(std::uint64_t offset, buffers::mutable_buffer mb)
+{
+    auto ov       = OVERLAPPED{};
+    ov.Offset     = static_cast<DWORD>(offset);
+    ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+    auto n     = mb.size();
+    auto chunk = static_cast<DWORD>(n > 0x40000000 ? 0x40000000 : n);
+    auto read  = DWORD{};
+    if(!::ReadFile(static_cast<HANDLE>(handle_), mb.data(), chunk, &read, &ov))
+    {
+        if(::GetLastError() == ERROR_HANDLE_EOF)
+            return 0;
+        throw_last_error("ReadFile");
+    }
+    return read;
+}
+
+#else
+
+sequential_file::sequential_file(const fs::path& path)
+{
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd_ == -1)
+        throw_last_error("open");
+
+    // Widens the kernel's readahead window, so the next
+    // reads are usually served from the page cache
+#ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+sequential_file::~sequential_file()
+{
+    ::close(fd_);
+}
+
+std::size_t
+sequential_file::read_at(std::uint64_t offset, buffers::mutable_buffer mb)
+{
+    for(;;)
+    {
+        auto rv =
+            ::pread(fd_, mb.data(), mb.size(), static_cast<off_t>(offset));
+        if(rv >= 0)
+            return static_cast<std::size_t>(rv);
+        if(errno != EINTR)
+            throw_last_error("pread");
+    }
+}
+
+#endif
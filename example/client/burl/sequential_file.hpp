@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_SEQUENTIAL_FILE_HPP
+#define BURL_SEQUENTIAL_FILE_HPP
+
+#include <boost/buffers/mutable_buffer.hpp>
+
+#include <cstdint>
+#include <filesystem>
+
+namespace buffers = boost::buffers;
+namespace fs      = std::filesystem;
+
+/** A file read front to back at explicit offsets
+
+    The file stays open between reads, and the system
+    is told it is read sequentially so it reads ahead
+    of the caller. A file that shrinks while it is read
+    just ends early.
+*/
+class sequential_file
+{
+#ifdef _WIN32
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+
+public:
+    /** Open a file for reading
+
+        @throws boost::system::system_error
+    */
+    explicit sequential_file(const fs::path& path);
+
+    sequential_file(const sequential_file&) = delete;
+
+    sequential_file&
+    operator=(const sequential_file&) = delete;
+
+    ~sequential_file();
+
+    /** Read some bytes at an offset
+
+        @return The number of bytes read, zero at the
+        end of the file.
+
+        @throws boost::system::system_error
+    */
+    std::size_t
+    read_at(std::uint64_t offset, buffers::mutable_buffer mb);
+};
+
+#endif
@@ -10,13 +10,22 @@
 #ifndef BURL_basic_task_group_HPP
 #define BURL_basic_task_group_HPP
 
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
 #include <boost/asio/bind_cancellation_slot.hpp>
 #include <boost/asio/compose.hpp>
 #include <boost/asio/consign.hpp>
 #include <boost/asio/immediate.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/steady_timer.hpp>
 
+#include <algorithm>
+#include <deque>
 #include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace asio   = boost::asio;
 using error_code = boost::system::error_code;
@@ -27,16 +36,90 @@ enum class task_group_errc
     closed
 };
 
+/** A group of tasks with bounded concurrency
+
+    Tasks take a slot for as long as their completion
+    handler lives. Besides the limit on the whole group,
+    each task belongs to a key, such as the origin it
+    talks to, and a key can hold only so many slots.
+
+    Tasks waiting for a slot are queued per key, and the
+    keys take turns, so a key with a long backlog or slow
+    tasks can't starve the others. A freed slot starts
+    exactly one queued task.
+*/
 template<typename Executor>
 class basic_task_group
 {
-    asio::steady_timer::rebind_executor<Executor>::other cv_;
+    class remover;
+    struct key_state;
+
+    struct pending
+    {
+        // A slot was taken for the task
+        virtual void
+        start(basic_task_group& tg, key_state* ks) = 0;
+
+        // The task was dropped without a slot
+        virtual void
+        abort(basic_task_group& tg, error_code ec) = 0;
+
+        virtual ~pending() = default;
+    };
+
+    using queue_type = std::list<std::unique_ptr<pending>>;
+
+    struct key_state
+    {
+        const std::string* key = nullptr;
+        std::uint32_t active   = 0;
+        bool in_ring           = false;
+        queue_type queue;
+    };
+
+    template<typename Handler, typename T>
+    class adapt_op;
+
+    template<typename T, typename Launch>
+    class submit_op;
+
+    using timer_type = asio::steady_timer::rebind_executor<Executor>::other;
+
+    // A caller of async_submit waiting for room in the
+    // queue. Each has its own timer, so that a freed
+    // place wakes one of them rather than all.
+    struct submitter
+    {
+        timer_type timer;
+        bool woken = false;
+
+        explicit submitter(const Executor& exec)
+            : timer{ exec, asio::steady_timer::time_point::max() }
+        {
+        }
+    };
+
+    Executor exec_;
+    timer_type join_cv_;
     std::uint32_t max_;
+    std::uint32_t max_per_key_;
+    std::size_t max_queued_;
+    std::uint32_t active_ = 0;
+    std::size_t queued_   = 0;
+    bool closed_          = false;
     std::list<asio::cancellation_signal> css_;
+    std::unordered_map<std::string, key_state> keys_;
+    std::deque<key_state*> ring_;
+    std::list<submitter> submitters_;
 
 public:
     typedef Executor executor_type;
 
+    template<typename T>
+    using handler_type = asio::cancellation_slot_binder<
+        asio::consign_t<std::decay_t<T>, remover>,
+        asio::cancellation_slot>;
+
     template<typename Executor1>
     struct rebind_executor
     {
@@ -45,22 +128,100 @@ public:
 
     basic_task_group(Executor exec, std::uint32_t max);
 
+    /** Constructor
+
+        @param max The number of tasks running at once.
+        @param max_per_key The number of tasks of one key
+        running at once.
+        @param max_queued The number of tasks that
+        @ref async_submit queues before it waits.
+    */
+    basic_task_group(
+        Executor exec,
+        std::uint32_t max,
+        std::uint32_t max_per_key,
+        std::size_t max_queued);
+
     basic_task_group(basic_task_group const&) = delete;
     basic_task_group(basic_task_group&&)      = delete;
 
+    /// Drop the queued tasks and refuse new ones
     void
     close();
 
     void
     emit(asio::cancellation_type type);
 
+    /// Return the number of tasks waiting for a slot
+    std::size_t
+    queued() const noexcept
+    {
+        return queued_;
+    }
+
+    /** Wait for a slot and adapt a completion handler
+
+        The handler holds the slot until it is destroyed.
+    */
     template<typename T, typename CompletionToken = asio::deferred_t>
     auto
     async_adapt(T&& t, CompletionToken&& completion_token = {});
 
+    /** Queue a task to start once a slot is free for its key
+
+        When the task gets its slot, `launch` is called
+        with the adapted completion handler `t`. This
+        completes once the task is queued, waiting while
+        the queue is full. Waiting callers are let in
+        in the order they arrived.
+    */
+    template<
+        typename T,
+        typename Launch,
+        typename CompletionToken = asio::deferred_t>
+    auto
+    async_submit(
+        std::string_view key,
+        T&& t,
+        Launch&& launch,
+        CompletionToken&& completion_token = {});
+
     template<typename CompletionToken = asio::deferred_t>
     auto
     async_join(CompletionToken&& completion_token = {});
+
+private:
+    template<typename T>
+    handler_type<T>
+    make_handler(T t, key_state* ks);
+
+    template<typename T>
+    static handler_type<T>
+    make_detached(T t);
+
+    key_state&
+    state(std::string_view key);
+
+    typename queue_type::iterator
+    enqueue(key_state& ks, std::unique_ptr<pending> p);
+
+    void
+    remove_queued(key_state& ks, typename queue_type::iterator it);
+
+    key_state*
+    next_key();
+
+    void
+    dispatch();
+
+    void
+    release(std::list<asio::cancellation_signal>::iterator cs, key_state* ks);
+
+    void
+    erase_if_idle(key_state* ks);
+
+    void
+    notify();
 };
 
 namespace boost
@@ -109,10 +270,129 @@ make_error_code(task_group_errc e)
     return { static_cast<int>(e), task_group_category() };
 }
 
+template<typename Executor>
+class basic_task_group<Executor>::remover
+{
+    basic_task_group* tg_ = nullptr;
+    std::list<asio::cancellation_signal>::iterator cs_;
+    key_state* ks_ = nullptr;
+
+public:
+    remover() = default;
+
+    remover(
+        basic_task_group* tg,
+        std::list<asio::cancellation_signal>::iterator cs,
+        key_state* ks)
+        : tg_{ tg }
+        , cs_{ cs }
+        , ks_{ ks }
+    {
+    }
+
+    remover(remover&& other) noexcept
+        : tg_{ std::exchange(other.tg_, nullptr) }
+        , cs_{ other.cs_ }
+        , ks_{ other.ks_ }
+    {
+    }
+
+    ~remover()
+    {
+        if(tg_)
+            tg_->release(cs_, ks_);
+    }
+};
+
+template<typename Executor>
+template<typename Handler, typename T>
+class basic_task_group<Executor>::adapt_op : public pending
+{
+    Handler handler_;
+    T t_;
+
+public:
+    adapt_op(Handler handler, T t)
+        : handler_{ std::move(handler) }
+        , t_{ std::move(t) }
+    {
+    }
+
+    void
+    start(basic_task_group& tg, key_state* ks) override
+    {
+        asio::get_associated_cancellation_slot(handler_).clear();
+        asio::post(
+            tg.exec_,
+            asio::append(
+                std::move(handler_),
+                error_code{},
+                tg.make_handler(std::move(t_), ks)));
+    }
+
+    void
+    abort(basic_task_group& tg, error_code ec) override
+    {
+        // On cancellation we are called from the slot's
+        // handler, which must not be destroyed while it runs
+        if(ec != task_group_errc::cancelled)
+            asio::get_associated_cancellation_slot(handler_).clear();
+        asio::post(
+            tg.exec_,
+            asio::append(
+                std::move(handler_), ec, make_detached(std::move(t_))));
+    }
+};
+
+template<typename Executor>
+template<typename T, typename Launch>
+class basic_task_group<Executor>::submit_op : public pending
+{
+    T t_;
+    Launch launch_;
+
+public:
+    submit_op(T t, Launch launch)
+        : t_{ std::move(t) }
+        , launch_{ std::move(launch) }
+    {
+    }
+
+    void
+    start(basic_task_group& tg, key_state* ks) override
+    {
+        // We may be called from the destructor of another
+        // task's handler, which must not run the launch
+        asio::post(
+            tg.exec_,
+            [launch  = std::move(launch_),
+             handler = tg.make_handler(std::move(t_), ks)]() mutable
+            { launch(std::move(handler)); });
+    }
+
+    void
+    abort(basic_task_group&, error_code) override
+    {
+    }
+};
+
 template<typename Executor>
 basic_task_group<Executor>::basic_task_group(Executor exec, std::uint32_t max)
-    : cv_{ std::move(exec), asio::steady_timer::time_point::max() }
+    : basic_task_group{ std::move(exec), max, max, std::size_t{ max } * 4 }
+{
+}
+
+template<typename Executor>
+basic_task_group<Executor>::basic_task_group(
+    Executor exec,
+    std::uint32_t max,
+    std::uint32_t max_per_key,
+    std::size_t max_queued)
+    : exec_{ exec }
+    , join_cv_{ exec, asio::steady_timer::time_point::max() }
     , max_{ max }
+    , max_per_key_{ max_per_key }
+    , max_queued_{ std::max<std::size_t>(max_queued, 1) }
 {
 }
 
@@ -120,8 +400,22 @@ template<typename Executor>
 void
 basic_task_group<Executor>::close()
 {
-    max_ = 0;
-    cv_.cancel();
+    closed_ = true;
+    for(auto& [_, ks] : keys_)
+    {
+        auto queue = std::move(ks.queue);
+        queued_   -= queue.size();
+        for(auto& p : queue)
+            p->abort(*this, task_group_errc::closed);
+    }
+    ring_.clear();
+    std::erase_if(
+        keys_,
+        [](const auto& kv)
+        { return kv.second.active == 0; });
+    for(auto& [_, ks] : keys_)
+        ks.in_ring = false;
+    notify();
 }
 
 template<typename Executor>
@@ -139,74 +433,102 @@ basic_task_group<Executor>::async_adapt(
     T&& t,
     CompletionToken&& completion_token)
 {
-    class remover
-    {
-        basic_task_group* tg_;
-        decltype(css_)::iterator cs_;
-
-    public:
-        remover(basic_task_group* tg, decltype(css_)::iterator cs)
-            : tg_{ tg }
-            , cs_{ cs }
+    return asio::async_initiate<
+        CompletionToken,
+        void(error_code, handler_type<T>)>(
+        [this](auto handler, std::decay_t<T> t)
         {
-        }
+            using op_type = adapt_op<decltype(handler), std::decay_t<T>>;
 
-        remover(remover&& other) noexcept
-            : tg_{ std::exchange(other.tg_, nullptr) }
-            , cs_{ other.cs_ }
-        {
-        }
+            auto slot = asio::get_associated_cancellation_slot(handler);
+            auto op   = std::make_unique<op_type>(
+                std::move(handler), std::move(t));
+            if(closed_)
+                return op->abort(*this, task_group_errc::closed);
 
-        ~remover()
-        {
-            if(tg_)
+            auto& ks = state({});
+            auto it  = enqueue(ks, std::move(op));
+            if(slot.is_connected())
             {
-                tg_->css_.erase(cs_);
-                tg_->cv_.cancel();
+                slot.assign(
+                    [this, &ks, it, done = false](
+                        asio::cancellation_type) mutable
+                    {
+                        if(!std::exchange(done, true))
+                            remove_queued(ks, it);
+                    });
             }
-        }
-    };
+            dispatch();
+        },
+        completion_token,
+        std::forward<T>(t));
+}
 
-    auto adaptor = [this, t = std::move(t)]() mutable
-    {
-        auto cs = css_.emplace(css_.end());
+template<typename Executor>
+template<typename T, typename Launch, typename CompletionToken>
+auto
+basic_task_group<Executor>::async_submit(
+    std::string_view key,
+    T&& t,
+    Launch&& launch,
+    CompletionToken&& completion_token)
+{
+    using op_type = submit_op<std::decay_t<T>, std::decay_t<Launch>>;
+
+    return asio::async_compose<CompletionToken, void(error_code)>(
+        [this,
+         key       = std::string{ key },
+         op        = std::make_unique<op_type>(
+             std::forward<T>(t), std::forward<Launch>(launch)),
+         waiter    = typename std::list<submitter>::iterator{},
+         waiting   = false,
+         scheduled = false](auto&& self, error_code ec = {}) mutable
+        {
+            if(!scheduled)
+                self.reset_cancellation_state(
+                    asio::enable_total_cancellation());
 
-        return asio::bind_cancellation_slot(
-            cs->slot(), asio::consign(std::move(t), remover{ this, cs }));
-    };
+            if(ec == asio::error::operation_aborted)
+                ec.clear();
 
-    return asio::
-        async_compose<CompletionToken, void(error_code, decltype(adaptor()))>(
-            [this, adaptor = std::move(adaptor), scheduled = false](
-                auto&& self, error_code ec = {}) mutable
-            {
-                if(!scheduled)
-                    self.reset_cancellation_state(
-                        asio::enable_total_cancellation());
+            if(!!self.cancelled())
+                ec = task_group_errc::cancelled;
 
-                if(ec == asio::error::operation_aborted)
-                    ec.clear();
+            if(closed_)
+                ec = task_group_errc::closed;
 
-                if(!!self.cancelled())
-                    ec = task_group_errc::cancelled;
+            if(waiting)
+                waiter->woken = false;
 
-                if(max_ == 0)
-                    ec = task_group_errc::closed;
+            // Keep our place in line while the queue is full
+            if(queued_ >= max_queued_ && !ec)
+            {
+                if(!std::exchange(waiting, true))
+                    waiter = submitters_.emplace(submitters_.end(), exec_);
+                scheduled = true;
+                return waiter->timer.async_wait(std::move(self));
+            }
 
-                if(css_.size() >= max_ && !ec)
-                {
-                    scheduled = true;
-                    return cv_.async_wait(std::move(self));
-                }
+            if(!std::exchange(scheduled, true))
+                return asio::async_immediate(exec_, std::move(self));
 
-                if(!std::exchange(scheduled, true))
-                    return asio::async_immediate(
-                        cv_.get_executor(), std::move(self));
+            if(std::exchange(waiting, false))
+                submitters_.erase(waiter);
 
-                self.complete(ec, adaptor());
-            },
-            completion_token,
-            cv_);
+            if(!ec)
+            {
+                enqueue(state(key), std::move(op));
+                dispatch();
+            }
+            else
+            {
+                // hand a wakeup we may have had to the next
+                notify();
+            }
+            self.complete(ec);
+        },
+        completion_token,
+        exec_);
 }
 
 template<typename Executor>
@@ -223,24 +545,173 @@ basic_task_group<Executor>::async_join(CompletionToken&& completion_token)
 
             if(!!self.cancelled())
             {
+                close();
                 emit(self.cancelled());
                 self.get_cancellation_state().clear();
             }
 
-            if(!css_.empty())
+            if(active_ != 0 || queued_ != 0)
             {
                 scheduled = true;
-                return cv_.async_wait(std::move(self));
+                return join_cv_.async_wait(std::move(self));
             }
 
             if(!std::exchange(scheduled, true))
                 return asio::async_immediate(
-                    cv_.get_executor(), std::move(self));
+                    join_cv_.get_executor(), std::move(self));
 
             self.complete();
         },
         completion_token,
-        cv_);
+        join_cv_);
+}
+
+template<typename Executor>
+template<typename T>
+auto
+basic_task_group<Executor>::make_handler(T t, key_state* ks)
+    -> handler_type<T>
+{
+    auto cs = css_.emplace(css_.end());
+    return asio::bind_cancellation_slot(
+        cs->slot(), asio::consign(std::move(t), remover{ this, cs, ks }));
+}
+
+template<typename Executor>
+template<typename T>
+auto
+basic_task_group<Executor>::make_detached(T t) -> handler_type<T>
+{
+    return asio::bind_cancellation_slot(
+        asio::cancellation_slot{}, asio::consign(std::move(t), remover{}));
+}
+
+template<typename Executor>
+auto
+basic_task_group<Executor>::state(std::string_view key) -> key_state&
+{
+    auto [it, inserted] = keys_.try_emplace(std::string{ key });
+    if(inserted)
+        it->second.key = &it->first;
+    return it->second;
+}
+
+template<typename Executor>
+auto
+basic_task_group<Executor>::enqueue(key_state& ks, std::unique_ptr<pending> p)
+    -> typename queue_type::iterator
+{
+    auto it = ks.queue.insert(ks.queue.end(), std::move(p));
+    ++queued_;
+    if(!std::exchange(ks.in_ring, true))
+        ring_.push_back(&ks);
+    return it;
+}
+
+template<typename Executor>
+void
+basic_task_group<Executor>::remove_queued(
+    key_state& ks,
+    typename queue_type::iterator it)
+{
+    auto p = std::move(*it);
+    ks.queue.erase(it);
+    --queued_;
+    p->abort(*this, task_group_errc::cancelled);
+
+    // the key leaves the ring on its next turn
+    notify();
+}
+
+// Round robin over the keys with queued tasks,
+// keys at their own limit are passed over.
+template<typename Executor>
+auto
+basic_task_group<Executor>::next_key() -> key_state*
+{
+    auto passed = std::size_t{};
+    while(!ring_.empty() && passed != ring_.size())
+    {
+        auto* ks = ring_.front();
+        ring_.pop_front();
+
+        if(ks->queue.empty())
+        {
+            ks->in_ring = false;
+            erase_if_idle(ks);
+            continue;
+        }
+
+        ring_.push_back(ks);
+        if(ks->active >= max_per_key_)
+        {
+            ++passed;
+            continue;
+        }
+        return ks;
+    }
+    return nullptr;
+}
+
+template<typename Executor>
+void
+basic_task_group<Executor>::dispatch()
+{
+    while(active_ < max_)
+    {
+        auto* ks = next_key();
+        if(!ks)
+            break;
+
+        auto p = std::move(ks->queue.front());
+        ks->queue.pop_front();
+        --queued_;
+        ++active_;
+        ++ks->active;
+        p->start(*this, ks);
+    }
+}
+
+template<typename Executor>
+void
+basic_task_group<Executor>::release(
+    std::list<asio::cancellation_signal>::iterator cs,
+    key_state* ks)
+{
+    css_.erase(cs);
+    --active_;
+    --ks->active;
+    erase_if_idle(ks);
+    dispatch();
+    notify();
+}
+
+template<typename Executor>
+void
+basic_task_group<Executor>::erase_if_idle(key_state* ks)
+{
+    if(ks->active == 0 && ks->queue.empty() && !ks->in_ring)
+        keys_.erase(*ks->key);
+}
+
+template<typename Executor>
+void
+basic_task_group<Executor>::notify()
+{
+    if(active_ == 0 && queued_ == 0)
+        join_cv_.cancel();
+
+    // Wake as many submitters, in order, as there are
+    // free places, passing over those already woken.
+    auto room = closed_ ? submitters_.size()
+                        : max_queued_ - std::min(queued_, max_queued_);
+    for(auto& s : submitters_)
+    {
+        if(room-- == 0)
+            break;
+        if(!std::exchange(s.woken, true))
+            s.timer.cancel();
+    }
 }
 
 using task_group = basic_task_group<asio::any_io_executor>;
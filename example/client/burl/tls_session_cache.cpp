@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#include "tls_session_cache.hpp"
+
+namespace
+{
+// TLS 1.3 tickets kept for each key
+constexpr auto max_tickets = std::size_t{ 4 };
+
+int
+cache_index()
+{
+    static const int index =
+        ::SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+void
+free_key(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*)
+{
+    delete static_cast<std::string*>(ptr);
+}
+
+int
+key_index()
+{
+    static const int index =
+        ::SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &free_key);
+    return index;
+}
+
+tls_session_cache*
+cache_of(SSL* ssl)
+{
+    return static_cast<tls_session_cache*>(
+        ::SSL_CTX_get_ex_data(::SSL_get_SSL_CTX(ssl), cache_index()));
+}
+
+bool
+is_ticket(const SSL_SESSION* session)
+{
+    return ::SSL_SESSION_get_protocol_version(session) >= TLS1_3_VERSION;
+}
+} // namespace
+
+tls_session_cache::tls_session_cache(ssl::context& ctx)
+    : ctx_{ ctx }
+{
+    auto* native = ctx_.native_handle();
+    ::SSL_CTX_set_ex_data(native, cache_index(), this);
+
+    // OpenSSL's own store is keyed by session id, which
+    // is of no use to a client. Sessions are handed to
+    // the callback instead.
+    ::SSL_CTX_set_session_cache_mode(
+        native, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    ::SSL_CTX_sess_set_new_cb(native, &on_new_session);
+}
+
+tls_session_cache::~tls_session_cache()
+{
+    auto* native = ctx_.native_handle();
+    ::SSL_CTX_sess_set_new_cb(native, nullptr);
+    ::SSL_CTX_set_ex_data(native, cache_index(), nullptr);
+
+    for(auto& [_, sessions] : sessions_)
+        for(auto* session : sessions)
+            ::SSL_SESSION_free(session);
+}
+
+void
+tls_session_cache::resume(SSL* ssl, const std::string& key)
+{
+    auto* cache = cache_of(ssl);
+    if(!cache)
+        return;
+
+    ::SSL_set_ex_data(ssl, key_index(), new std::string{ key });
+
+    auto it = cache->sessions_.find(key);
+    if(it == cache->sessions_.end())
+        return;
+
+    auto& sessions = it->second;
+    while(!sessions.empty())
+    {
+        auto* session = sessions.back();
+        if(!::SSL_SESSION_is_resumable(session))
+        {
+            ::SSL_SESSION_free(session);
+            sessions.pop_back();
+            continue;
+        }
+
+        // the connection takes its own reference
+        ::SSL_set_session(ssl, session);
+
+        // a ticket is offered once
+        if(is_ticket(session))
+        {
+            ::SSL_SESSION_free(session);
+            sessions.pop_back();
+        }
+        break;
+    }
+
+    if(sessions.empty())
+        cache->sessions_.erase(it);
+}
+
+// Called for each session the server issues, which
+// with TLS 1.3 happens after the handshake.
+int
+tls_session_cache::on_new_session(SSL* ssl, SSL_SESSION* session)
+{
+    auto* cache = cache_of(ssl);
+    auto* key   = static_cast<std::string*>(::SSL_get_ex_data(ssl, key_index()));
+    if(!cache || !key)
+        return 0;
+
+    // A TLS 1.2 session can be resumed any number of
+    // times, only the latest one is kept.
+    auto& sessions = cache->sessions_[*key];
+    if(!is_ticket(session) || sessions.size() >= max_tickets)
+    {
+        auto n = is_ticket(session) ? 1 : sessions.size();
+        for(auto i = std::size_t{}; i != n; ++i)
+            ::SSL_SESSION_free(sessions[i]);
+        sessions.erase(sessions.begin(), sessions.begin() + n);
+    }
+    sessions.push_back(session);
+
+    // keep the reference OpenSSL passed in
+    return 1;
+}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2024 Mohammad Nejati
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/cppalliance/http_io
+//
+
+#ifndef BURL_TLS_SESSION_CACHE_HPP
+#define BURL_TLS_SESSION_CACHE_HPP
+
+#include <boost/asio/ssl/context.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ssl = boost::asio::ssl;
+
+/** TLS sessions kept for resumption
+
+    Installing the cache on an SSL context makes it
+    collect the sessions and tickets servers issue to
+    connections made from that context, keyed like
+    the connection pool so that a session is only
+    offered to the origin, port and proxy it came
+    from. A new connection offers the latest one and
+    skips the full handshake if the server accepts it.
+
+    TLS 1.3 tickets are taken out of the cache when
+    offered, as RFC 8446 C.4 asks clients not to use
+    one twice. Parallel connections each get their
+    own ticket while enough are cached.
+
+    The cache must outlive every connection made from
+    the context after it was installed.
+*/
+class tls_session_cache
+{
+    ssl::context& ctx_;
+    std::unordered_map<std::string, std::vector<SSL_SESSION*>> sessions_;
+
+public:
+    explicit tls_session_cache(ssl::context& ctx);
+
+    tls_session_cache(const tls_session_cache&) = delete;
+
+    tls_session_cache&
+    operator=(const tls_session_cache&) = delete;
+
+    ~tls_session_cache();
+
+    /** Offer a cached session on a new connection
+
+        Sessions the server issues to the connection
+        are cached under the same key. This does
+        nothing if the connection's context has no
+        cache installed.
+    */
+    static void
+    resume(SSL* ssl, const std::string& key);
+
+private:
+    static int
+    on_new_session(SSL* ssl, SSL_SESSION* session);
+};
+
+#endif
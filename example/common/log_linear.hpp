@@ -0,0 +1,79 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_COMMON_LOG_LINEAR_HPP
+#define BOOST_HTTP_IO_EXAMPLE_COMMON_LOG_LINEAR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/** Bucket layout of a log-linear histogram
+
+    Like HdrHistogram, each power of two is split
+    into `1 << SubBits` linear sub-buckets, bounding
+    the relative error of any value to `2^-SubBits`
+    across the full 64-bit range. Values below the
+    first power of two get a bucket each.
+
+    This is shared by the server's metrics and the
+    benchmark client, which differ only in precision.
+*/
+template<unsigned SubBits>
+struct log_linear
+{
+    static constexpr unsigned sub_bits = SubBits;
+    static constexpr std::size_t size =
+        (64 - sub_bits + 1) << sub_bits;
+
+    // Index of the most significant set bit, v != 0
+    static
+    unsigned
+    highest_bit(std::uint64_t v) noexcept
+    {
+        unsigned n = 0;
+        for(unsigned shift = 32; shift != 0; shift /= 2)
+        {
+            if(v >> shift)
+            {
+                v >>= shift;
+                n += shift;
+            }
+        }
+        return n;
+    }
+
+    // bucket counting `v`
+    static
+    std::size_t
+    index(std::uint64_t v) noexcept
+    {
+        constexpr std::uint64_t sub = 1u << sub_bits;
+        if(v < sub)
+            return static_cast<std::size_t>(v);
+        auto const shift = highest_bit(v) - sub_bits;
+        return static_cast<std::size_t>(
+            ((shift + 1) << sub_bits) +
+            ((v >> shift) & (sub - 1)));
+    }
+
+    // highest value counted by bucket `i`
+    static
+    std::uint64_t
+    highest(std::size_t i) noexcept
+    {
+        constexpr std::uint64_t sub = 1u << sub_bits;
+        if(i < sub)
+            return i;
+        auto const shift = (i >> sub_bits) - 1;
+        auto const low = (sub + (i & (sub - 1))) << shift;
+        return low + ((std::uint64_t(1) << shift) - 1);
+    }
+};
+
+#endif
@@ -10,15 +10,44 @@
 #ifndef BOOST_HTTP_IO_EXAMPLE_ACCEPTOR_HPP
 #define BOOST_HTTP_IO_EXAMPLE_ACCEPTOR_HPP
 
+#include "access_log.hpp"
+#include "admission.hpp"
+#include "buffer_pool.hpp"
+#include "error_pages.hpp"
 #include "fixed_array.hpp"
+#include "metrics.hpp"
+#include "proxy.hpp"
+#include "router.hpp"
 #include "server.hpp"
+#include "timer_wheel.hpp"
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/http_proto/context.hpp>
-#include <string>
 
 template< class Executor >
 class worker;
 
+/** Deadlines for each phase of a connection
+
+    The body and write deadlines are re-armed on each
+    read or write, so they bound the time a peer may
+    go without making progress, not the length of
+    the whole transfer.
+*/
+struct worker_timeouts
+{
+    // receiving the request header
+    timer_wheel::duration header = std::chrono::seconds(10);
+
+    // each read of the request body
+    timer_wheel::duration body = std::chrono::seconds(30);
+
+    // each write of the response
+    timer_wheel::duration write = std::chrono::seconds(30);
+
+    // waiting for the next request on a keep-alive connection
+    timer_wheel::duration idle = std::chrono::seconds(15);
+};
+
 template< class Executor >
 class acceptor : public server::service
 {
@@ -33,6 +62,15 @@ private:
     server& srv_;
     acceptor_type sock_;
     boost::http_proto::context& ctx_;
+    error_pages const& pages_;
+    timer_wheel& timers_;
+    admission& admit_;
+    server_metrics& metrics_;
+    access_log& log_;
+    router const& routes_;
+    proxy* proxy_;
+    worker_timeouts timeouts_;
+    buffer_pool pool_;
     std::size_t id_ = 0;
     fixed_array< worker< executor_type > > wv_;
 
@@ -41,12 +79,26 @@ public:
         server& srv,
         boost::asio::ip::tcp::endpoint ep,
         boost::http_proto::context& ctx,
-        std::size_t num_workers,
-        std::string const& doc_root)
+        error_pages const& pages,
+        timer_wheel& timers,
+        admission& admit,
+        server_metrics& metrics,
+        access_log& log,
+        router const& routes,
+        proxy* px,
+        std::size_t num_workers)
         : srv_(srv)
         , sock_(srv.make_executor(), ep)
         , ctx_(ctx)
-        , wv_(num_workers, srv, *this, doc_root)
+        , pages_(pages)
+        , timers_(timers)
+        , admit_(admit)
+        , metrics_(metrics)
+        , log_(log)
+        , routes_(routes)
+        , proxy_(px)
+        , pool_(ctx)
+        , wv_(num_workers, srv, *this)
     {
     }
 
@@ -74,6 +126,61 @@ public:
         return ctx_;
     }
 
+    error_pages const&
+    pages() const noexcept
+    {
+        return pages_;
+    }
+
+    timer_wheel&
+    timers() noexcept
+    {
+        return timers_;
+    }
+
+    admission&
+    admit() noexcept
+    {
+        return admit_;
+    }
+
+    server_metrics&
+    metrics() noexcept
+    {
+        return metrics_;
+    }
+
+    access_log&
+    log() noexcept
+    {
+        return log_;
+    }
+
+    router const&
+    routes() const noexcept
+    {
+        return routes_;
+    }
+
+    // Return the reverse proxy, or nullptr
+    proxy*
+    get_proxy() const noexcept
+    {
+        return proxy_;
+    }
+
+    buffer_pool&
+    pool() noexcept
+    {
+        return pool_;
+    }
+
+    worker_timeouts&
+    timeouts() noexcept
+    {
+        return timeouts_;
+    }
+
     void
     run() override
     {
@@ -81,6 +188,17 @@ public:
             w.run();
     }
 
+    void
+    drain() override
+    {
+        // refuse new connections
+        boost::system::error_code ec;
+        sock_.close(ec);
+        for(auto& w : wv_)
+            w.drain();
+        pool_.trim();
+    }
+
     void
     stop() override
     {
@@ -0,0 +1,357 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "access_log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <system_error>
+
+#ifdef _WIN32
+# include <fcntl.h>
+# include <io.h>
+#else
+# include <fcntl.h>
+# include <sys/uio.h>
+# include <unistd.h>
+#endif
+
+namespace {
+
+// Copy as much of `s` as fits, null-terminated
+template<std::size_t N>
+void
+copy_truncated(
+    char (&dest)[N],
+    boost::core::string_view s) noexcept
+{
+    auto const n = (std::min)(s.size(), N - 1);
+    std::memcpy(dest, s.data(), n);
+    dest[n] = 0;
+}
+
+} // (anon)
+
+access_log::
+access_log(std::string const& path)
+{
+    if(path.empty())
+        return;
+    if(path == "-")
+    {
+        fd_ = 2;
+        return;
+    }
+#ifdef _WIN32
+    fd_ = ::_open(path.c_str(),
+        _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY,
+        _S_IREAD | _S_IWRITE);
+#else
+    fd_ = ::open(path.c_str(),
+        O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+    if(fd_ == -1)
+        throw std::system_error(errno,
+            std::generic_category(), path);
+    owns_fd_ = true;
+}
+
+access_log::
+~access_log()
+{
+    stop();
+    if(owns_fd_)
+    {
+#ifdef _WIN32
+        ::_close(fd_);
+#else
+        ::close(fd_);
+#endif
+    }
+}
+
+void
+access_log::
+access(
+    std::size_t id,
+    boost::core::string_view method,
+    boost::core::string_view target,
+    unsigned status,
+    std::uint64_t bytes,
+    std::chrono::steady_clock::duration elapsed) noexcept
+{
+    if(! enabled())
+        return;
+    auto& q = local();
+    auto r = prepare(q);
+    if(! r)
+        return;
+    r->when = clock_type::now();
+    r->id = id;
+    r->type = kind::access;
+    r->status = static_cast<unsigned short>(status);
+    r->micros = static_cast<std::uint32_t>((std::min)(
+        std::chrono::duration_cast<
+            std::chrono::microseconds>(elapsed).count(),
+        std::chrono::microseconds::rep(UINT32_MAX)));
+    r->bytes = bytes;
+    copy_truncated(r->method, method);
+    copy_truncated(r->target, target);
+    commit(q);
+}
+
+void
+access_log::
+error(
+    std::size_t id,
+    char const* what,
+    boost::system::error_code const& ec) noexcept
+{
+    if(! enabled())
+        return;
+    auto& q = local();
+    auto r = prepare(q);
+    if(! r)
+        return;
+    r->when = clock_type::now();
+    r->id = id;
+    r->type = kind::error;
+    r->what = what;
+    r->category = &ec.category();
+    r->value = ec.value();
+    commit(q);
+}
+
+std::uint64_t
+access_log::
+dropped() const noexcept
+{
+    std::uint64_t n = 0;
+    rings_.for_each([&n](ring const& q)
+    {
+        n += q.dropped.load(std::memory_order_relaxed);
+    });
+    return n;
+}
+
+void
+access_log::
+run()
+{
+    if(! enabled() || thread_.joinable())
+        return;
+    thread_ = std::thread(&access_log::do_write, this);
+}
+
+void
+access_log::
+stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        is_stopped_ = true;
+    }
+    cv_.notify_one();
+    if(thread_.joinable())
+        thread_.join();
+}
+
+//------------------------------------------------
+
+// Return the next free slot, or nullptr if full
+auto
+access_log::
+prepare(ring& q) noexcept ->
+    record*
+{
+    auto const tail =
+        q.tail.load(std::memory_order_relaxed);
+    if(tail - q.head.load(
+        std::memory_order_acquire) == capacity)
+    {
+        q.dropped.store(q.dropped.load(
+            std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &q.slots[tail % capacity];
+}
+
+// Publish the slot returned by prepare
+void
+access_log::
+commit(ring& q) noexcept
+{
+    q.tail.store(q.tail.load(
+        std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+}
+
+void
+access_log::
+format(
+    record const& r,
+    std::string& dest)
+{
+    char buf[64];
+    auto const t = clock_type::to_time_t(r.when);
+    auto const ms = std::chrono::duration_cast<
+        std::chrono::milliseconds>(
+            r.when.time_since_epoch()).count() % 1000;
+    std::tm tm;
+#ifdef _WIN32
+    ::gmtime_s(&tm, &t);
+#else
+    ::gmtime_r(&t, &tm);
+#endif
+    auto n = std::strftime(buf, sizeof(buf),
+        "%Y-%m-%dT%H:%M:%S", &tm);
+    n += std::snprintf(buf + n, sizeof(buf) - n,
+        ".%03dZ [%zu] ", static_cast<int>(ms), r.id);
+    dest.append(buf, n);
+
+    if(r.type == kind::access)
+    {
+        dest.push_back('"');
+        dest.append(r.method).push_back(' ');
+        dest.append(r.target).push_back('"');
+        n = std::snprintf(buf, sizeof(buf),
+            " %u %llu %.6f\n",
+            static_cast<unsigned>(r.status),
+            static_cast<unsigned long long>(r.bytes),
+            static_cast<double>(r.micros) / 1e6);
+        dest.append(buf, n);
+        return;
+    }
+
+    dest.append(r.what).append(": ");
+    dest.append(r.category->message(r.value));
+    dest.push_back('\n');
+}
+
+void
+access_log::
+do_write()
+{
+    std::unique_lock<std::mutex> lock(m_);
+    for(;;)
+    {
+        // Producers never signal, so records
+        // are collected in periodic batches.
+        cv_.wait_for(lock,
+            std::chrono::milliseconds(100),
+            [this]{ return is_stopped_; });
+        auto const stopping = is_stopped_;
+        lock.unlock();
+        flush();
+        if(stopping)
+            return;
+        lock.lock();
+    }
+}
+
+void
+access_log::
+flush()
+{
+    std::vector<ring*> rings;
+    rings_.for_each([&rings](ring& q)
+    {
+        rings.push_back(&q);
+    });
+
+    text_.resize(rings.size());
+    for(std::size_t i = 0; i < rings.size(); ++i)
+    {
+        auto& q = *rings[i];
+        auto& dest = text_[i];
+        dest.clear();
+
+        auto const head =
+            q.head.load(std::memory_order_relaxed);
+        auto const tail =
+            q.tail.load(std::memory_order_acquire);
+        for(auto j = head; j != tail; ++j)
+            format(q.slots[j % capacity], dest);
+        q.head.store(tail, std::memory_order_release);
+
+        auto const dropped =
+            q.dropped.load(std::memory_order_relaxed);
+        if(dropped != q.reported)
+        {
+            dest.append("access_log: ");
+            dest.append(std::to_string(
+                dropped - q.reported));
+            dest.append(" records dropped\n");
+            q.reported = dropped;
+        }
+    }
+    write_all();
+}
+
+// Write every batch, gathering them into
+// as few system calls as possible.
+void
+access_log::
+write_all() noexcept
+{
+#ifdef _WIN32
+    for(auto const& s : text_)
+    {
+        auto p = s.data();
+        auto n = s.size();
+        while(n > 0)
+        {
+            auto const rv = ::_write(fd_, p,
+                static_cast<unsigned>(n));
+            if(rv <= 0)
+                return;
+            p += rv;
+            n -= static_cast<std::size_t>(rv);
+        }
+    }
+#else
+    std::vector<iovec> iov;
+    for(auto const& s : text_)
+    {
+        if(s.empty())
+            continue;
+        iovec v;
+        v.iov_base = const_cast<char*>(s.data());
+        v.iov_len = s.size();
+        iov.push_back(v);
+    }
+
+    std::size_t i = 0;
+    while(i < iov.size())
+    {
+        auto const rv = ::writev(fd_, &iov[i],
+            static_cast<int>(iov.size() - i));
+        if(rv < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return;
+        }
+
+        // skip what was written
+        auto n = static_cast<std::size_t>(rv);
+        while(i < iov.size() && n >= iov[i].iov_len)
+            n -= iov[i++].iov_len;
+        if(i < iov.size())
+        {
+            iov[i].iov_base =
+                static_cast<char*>(iov[i].iov_base) + n;
+            iov[i].iov_len -= n;
+        }
+    }
+#endif
+}
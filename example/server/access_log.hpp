@@ -0,0 +1,147 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_ACCESS_LOG_HPP
+#define BOOST_HTTP_IO_EXAMPLE_ACCESS_LOG_HPP
+
+#include "server.hpp"
+#include "thread_shards.hpp"
+#include <boost/core/detail/string_view.hpp>
+#include <boost/system/error_code.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** An asynchronous access and error log
+
+    Workers never perform I/O to log. Each thread
+    which logs gets its own single-producer ring of
+    fixed-size records, and a background thread
+    formats them and writes each batch to the file
+    with one gathered write.
+
+    When a ring is full the record is dropped and
+    counted rather than blocking the event loop.
+    The number dropped is written to the log.
+*/
+class access_log : public server::service
+{
+public:
+    using clock_type = std::chrono::system_clock;
+
+    /** Constructor
+
+        @param path The file to append to, "-" for
+        standard error, or empty to disable logging.
+    */
+    explicit
+    access_log(std::string const& path);
+
+    ~access_log();
+
+    bool
+    enabled() const noexcept
+    {
+        return fd_ != -1;
+    }
+
+    /** Log a completed request
+    */
+    void
+    access(
+        std::size_t id,
+        boost::core::string_view method,
+        boost::core::string_view target,
+        unsigned status,
+        std::uint64_t bytes,
+        std::chrono::steady_clock::duration elapsed) noexcept;
+
+    /** Log a failed operation
+
+        @param what A string with static storage duration.
+    */
+    void
+    error(
+        std::size_t id,
+        char const* what,
+        boost::system::error_code const& ec) noexcept;
+
+    // number of records lost to full rings
+    std::uint64_t
+    dropped() const noexcept;
+
+    void run() override;
+    void stop() override;
+
+private:
+    enum class kind : unsigned char
+    {
+        access,
+        error
+    };
+
+    struct record
+    {
+        clock_type::time_point when;
+        std::size_t id;
+        kind type;
+
+        // access
+        unsigned short status;
+        std::uint32_t micros;
+        std::uint64_t bytes;
+        char method[16];
+        char target[128];
+
+        // error
+        char const* what;
+        boost::system::error_category const* category;
+        int value;
+    };
+
+    static constexpr std::size_t capacity = 1024;
+
+    struct ring
+    {
+        std::atomic<std::size_t> head{0}; // consumer
+        std::atomic<std::size_t> tail{0}; // producer
+        std::atomic<std::uint64_t> dropped{0};
+        std::uint64_t reported = 0; // consumer
+        record slots[capacity];
+    };
+
+    ring&
+    local()
+    {
+        return rings_.local();
+    }
+
+    static record* prepare(ring& q) noexcept;
+    static void commit(ring& q) noexcept;
+    static void format(record const& r, std::string& dest);
+    void do_write();
+    void flush();
+    void write_all() noexcept;
+
+    int fd_ = -1;
+    bool owns_fd_ = false;
+    std::mutex m_;
+    std::condition_variable cv_;
+    thread_shards<ring> rings_;
+    std::vector<std::string> text_; // consumer
+    std::thread thread_;
+    bool is_stopped_ = false;
+};
+
+#endif
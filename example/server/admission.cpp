@@ -0,0 +1,176 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "admission.hpp"
+#include "metrics.hpp"
+#include <boost/assert.hpp>
+#include <cmath>
+#include <functional>
+
+admission::
+admission(server& srv)
+    : probe_(srv.make_executor())
+{
+}
+
+bool
+admission::
+try_begin()
+{
+    if( limits_.max_in_flight != 0 &&
+        in_flight_ >= limits_.max_in_flight)
+    {
+        ++shed_;
+        return false;
+    }
+
+    if(dropping_)
+    {
+        auto const now = clock_type::now();
+        if(now >= drop_next_)
+        {
+            ++count_;
+            drop_next_ += control_law();
+            ++shed_;
+            return false;
+        }
+    }
+
+    ++in_flight_;
+    return true;
+}
+
+void
+admission::
+end() noexcept
+{
+    BOOST_ASSERT(in_flight_ > 0);
+    --in_flight_;
+}
+
+void
+admission::
+append_metrics(std::string& dest) const
+{
+    using seconds = std::chrono::duration<double>;
+    server_metrics::append_gauge(dest,
+        "http_io_admission_max_in_flight",
+        "Requests admitted at once, 0 for no limit.",
+        static_cast<double>(limits_.max_in_flight));
+    server_metrics::append_gauge(dest,
+        "http_io_admission_target_seconds",
+        "Acceptable standing queueing delay.",
+        seconds(limits_.target).count());
+    server_metrics::append_gauge(dest,
+        "http_io_admission_in_flight",
+        "Requests admitted and not yet answered.",
+        static_cast<double>(in_flight_));
+    server_metrics::append_gauge(dest,
+        "http_io_admission_delay_seconds",
+        "Most recent queueing delay sample.",
+        seconds(delay_).count());
+    server_metrics::append_gauge(dest,
+        "http_io_admission_dropping",
+        "1 while requests are being shed.",
+        dropping_ ? 1 : 0);
+    server_metrics::append_counter(dest,
+        "http_io_admission_shed_total",
+        "Requests answered with 503.", shed_);
+    server_metrics::append_counter(dest,
+        "http_io_admission_refused_total",
+        "Connections closed on accept.", refused_);
+}
+
+void
+admission::
+run()
+{
+    do_probe();
+}
+
+void
+admission::
+stop()
+{
+    is_stopped_ = true;
+    probe_.cancel();
+}
+
+// interval / sqrt(count)
+auto
+admission::
+control_law() const noexcept ->
+    duration
+{
+    return std::chrono::duration_cast<duration>(
+        limits_.interval / std::sqrt(
+            static_cast<double>(count_)));
+}
+
+void
+admission::
+sample(
+    duration delay,
+    clock_type::time_point now)
+{
+    delay_ = delay;
+
+    if(delay < limits_.target)
+    {
+        first_above_ = {};
+        dropping_ = false;
+        return;
+    }
+
+    if(first_above_ == clock_type::time_point())
+    {
+        first_above_ = now + limits_.interval;
+        return;
+    }
+
+    if(dropping_ || now < first_above_)
+        return;
+
+    // Start shedding. If the last episode ended
+    // recently, resume close to its final rate.
+    dropping_ = true;
+    if( count_ > 2 &&
+        now - drop_next_ < 16 * limits_.interval)
+        count_ -= 2;
+    else
+        count_ = 1;
+    drop_next_ = now + control_law();
+}
+
+void
+admission::
+do_probe()
+{
+    probe_.expires_after(limits_.interval / 10);
+    probe_.async_wait(std::bind(
+        &admission::on_probe, this,
+        std::placeholders::_1));
+}
+
+void
+admission::
+on_probe(
+    boost::system::error_code const& ec)
+{
+    if(ec.failed() || is_stopped_)
+        return;
+
+    // Lateness of the expiry is the time this
+    // handler spent queued behind other work.
+    auto const now = clock_type::now();
+    auto const late = now - probe_.expiry();
+    sample(late < duration::zero() ?
+        duration::zero() : late, now);
+    do_probe();
+}
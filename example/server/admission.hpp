@@ -0,0 +1,165 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_ADMISSION_HPP
+#define BOOST_HTTP_IO_EXAMPLE_ADMISSION_HPP
+
+#include "server.hpp"
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/** Latency-aware admission control
+
+    This service decides whether new connections
+    and requests are admitted. It combines a hard
+    limit on requests in flight with a CoDel-style
+    controller driven by the queueing delay of the
+    event loop.
+
+    The delay is sampled by a probe timer: the
+    lateness of each expiry is the time ready
+    handlers spent waiting for the thread. When
+    that delay stays above `target` for a whole
+    `interval` the server is overloaded. While
+    overloaded, new connections are refused and
+    requests are shed at a rate which increases
+    with the square root of the number shed, as
+    in RFC 8289, until the delay falls back below
+    the target.
+*/
+class admission : public server::service
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using duration = clock_type::duration;
+
+    struct limits
+    {
+        // Requests admitted at once, 0 for no limit
+        std::size_t max_in_flight = 0;
+
+        // Acceptable standing queueing delay
+        duration target = std::chrono::milliseconds(5);
+
+        // How long the delay must persist
+        duration interval = std::chrono::milliseconds(100);
+    };
+
+    explicit
+    admission(server& srv);
+
+    /** Return the current limits
+
+        The limits may be changed at any time.
+    */
+    limits&
+    get_limits() noexcept
+    {
+        return limits_;
+    }
+
+    /** Return `true` if new connections should be accepted
+    */
+    bool
+    accepting() const noexcept
+    {
+        return ! dropping_;
+    }
+
+    /** Try to admit a request
+
+        If this returns `true`, @ref end must be
+        called once the response has been sent.
+        Otherwise the request should be answered
+        with 503 Service Unavailable.
+    */
+    bool
+    try_begin();
+
+    void
+    end() noexcept;
+
+    std::size_t
+    in_flight() const noexcept
+    {
+        return in_flight_;
+    }
+
+    /** Return the most recent queueing delay sample
+    */
+    duration
+    delay() const noexcept
+    {
+        return delay_;
+    }
+
+    bool
+    is_overloaded() const noexcept
+    {
+        return dropping_;
+    }
+
+    // number of requests answered with 503
+    std::uint64_t
+    shed() const noexcept
+    {
+        return shed_;
+    }
+
+    // number of connections closed on accept
+    std::uint64_t
+    refused() const noexcept
+    {
+        return refused_;
+    }
+
+    void
+    refuse() noexcept
+    {
+        ++refused_;
+    }
+
+    /** Append the limits and state in Prometheus text format
+
+        This is meant to be added as a collector of
+        @ref server_metrics. The state is read without
+        synchronization, so scrapes which include it
+        must be rendered on the server's thread.
+    */
+    void
+    append_metrics(std::string& dest) const;
+
+    void run() override;
+    void stop() override;
+
+private:
+    duration control_law() const noexcept;
+    void sample(duration delay, clock_type::time_point now);
+    void do_probe();
+    void on_probe(boost::system::error_code const&);
+
+    boost::asio::basic_waitable_timer<
+        clock_type,
+        boost::asio::wait_traits<clock_type>,
+        server::executor_type> probe_;
+    limits limits_;
+    duration delay_ = duration::zero();
+    clock_type::time_point first_above_;
+    clock_type::time_point drop_next_;
+    std::size_t in_flight_ = 0;
+    std::uint32_t count_ = 0;
+    std::uint64_t shed_ = 0;
+    std::uint64_t refused_ = 0;
+    bool dropping_ = false;
+    bool is_stopped_ = false;
+};
+
+#endif
@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "buffer_pool.hpp"
+#include <boost/assert.hpp>
+
+namespace http_proto = boost::http_proto;
+
+buffer_pool::
+buffer_pool(
+    http_proto::context& ctx,
+    std::size_t serializer_size,
+    std::size_t max_free)
+    : ctx_(ctx)
+    , serializer_size_(serializer_size)
+    , max_free_(max_free)
+{
+}
+
+auto
+buffer_pool::
+acquire_parser() ->
+    parser_ptr
+{
+    ++in_use_;
+    if(parsers_.empty())
+        return parser_ptr(new
+            http_proto::request_parser(ctx_));
+    auto pr = std::move(parsers_.back());
+    parsers_.pop_back();
+    return pr;
+}
+
+auto
+buffer_pool::
+acquire_serializer() ->
+    serializer_ptr
+{
+    ++in_use_;
+    if(serializers_.empty())
+        return serializer_ptr(new
+            http_proto::serializer(
+                ctx_, serializer_size_));
+    auto sr = std::move(serializers_.back());
+    serializers_.pop_back();
+    return sr;
+}
+
+void
+buffer_pool::
+release(parser_ptr& pr) noexcept
+{
+    if(! pr)
+        return;
+    BOOST_ASSERT(in_use_ > 0);
+    --in_use_;
+    if(parsers_.size() >= max_free_)
+    {
+        pr.reset();
+        return;
+    }
+    pr->reset();
+    parsers_.emplace_back(std::move(pr));
+}
+
+void
+buffer_pool::
+release(serializer_ptr& sr) noexcept
+{
+    if(! sr)
+        return;
+    BOOST_ASSERT(in_use_ > 0);
+    --in_use_;
+    if(serializers_.size() >= max_free_)
+    {
+        sr.reset();
+        return;
+    }
+    serializers_.emplace_back(std::move(sr));
+}
+
+void
+buffer_pool::
+trim() noexcept
+{
+    parsers_.clear();
+    serializers_.clear();
+}
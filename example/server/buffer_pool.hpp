@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_BUFFER_POOL_HPP
+#define BOOST_HTTP_IO_EXAMPLE_BUFFER_POOL_HPP
+
+#include <boost/http_proto/context.hpp>
+#include <boost/http_proto/request_parser.hpp>
+#include <boost/http_proto/serializer.hpp>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/** A pool of parsers and serializers
+
+    Parsers and serializers allocate their buffers
+    up front, so a connection which owned its own
+    would pin them while idle between keep-alive
+    requests. Instead, connections borrow from this
+    pool while reading or writing and give them back
+    while waiting, so memory grows with the number
+    of active connections rather than open ones.
+*/
+class buffer_pool
+{
+public:
+    using parser_ptr = std::unique_ptr<
+        boost::http_proto::request_parser>;
+    using serializer_ptr = std::unique_ptr<
+        boost::http_proto::serializer>;
+
+    /** Constructor
+
+        @param serializer_size The buffer size of
+        each serializer.
+
+        @param max_free The number of each kind kept
+        for reuse. Any more returned are destroyed.
+    */
+    buffer_pool(
+        boost::http_proto::context& ctx,
+        std::size_t serializer_size = 65536,
+        std::size_t max_free = 64);
+
+    /** Borrow a parser
+
+        The parser is reset, and must be started
+        before use.
+    */
+    parser_ptr
+    acquire_parser();
+
+    serializer_ptr
+    acquire_serializer();
+
+    /** Return a parser
+
+        Any data buffered in the parser is discarded.
+    */
+    void
+    release(parser_ptr& pr) noexcept;
+
+    void
+    release(serializer_ptr& sr) noexcept;
+
+    // number of parsers and serializers lent out
+    std::size_t
+    in_use() const noexcept
+    {
+        return in_use_;
+    }
+
+    // Destroy everything kept for reuse
+    void
+    trim() noexcept;
+
+private:
+    boost::http_proto::context& ctx_;
+    std::size_t serializer_size_;
+    std::size_t max_free_;
+    std::size_t in_use_ = 0;
+    std::vector<parser_ptr> parsers_;
+    std::vector<serializer_ptr> serializers_;
+};
+
+#endif
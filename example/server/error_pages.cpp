@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "error_pages.hpp"
+#include <boost/assert.hpp>
+#include <boost/buffers/const_buffer.hpp>
+#include <boost/http_proto/field.hpp>
+#include <boost/url/parse.hpp>
+#include <array>
+#include <type_traits>
+
+namespace buffers = boost::buffers;
+namespace http_proto = boost::http_proto;
+namespace urls = boost::urls;
+
+error_pages::
+error_pages(bool show_address)
+    : show_address_(show_address)
+{
+    for(auto n = first_code; n <= last_code; ++n)
+    {
+        auto const code = http_proto::int_to_status(n);
+        if(code == http_proto::status::unknown)
+            continue;
+
+        auto& s = pages_[n - first_code].head;
+        s  = "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\n";
+        s += "<html><head>\n";
+        s += "<title>";
+            s += std::to_string(n);
+            s += " ";
+            s += http_proto::obsolete_reason(code);
+            s += "</title>\n";
+        s += "</head><body>\n";
+        s += "<h1>";
+            s += http_proto::obsolete_reason(code);
+            s += "</h1>\n";
+        s.shrink_to_fit();
+    }
+
+    // Without the address footer the whole page
+    // is static and the scratch buffer stays empty.
+    if(! show_address_)
+    {
+        tail_  = "<hr>\n";
+        tail_ += "<address>Boost.Http.IO/1.0b (Win10) Server</address>\n";
+    }
+    tail_ += "</body></html>\n";
+}
+
+void
+error_pages::
+start(
+    http_proto::status code,
+    http_proto::request_view const& req,
+    http_proto::response& res,
+    http_proto::serializer& sr,
+    std::string& scratch,
+    bool keep_alive) const
+{
+    auto const n = static_cast<
+        std::underlying_type<
+            http_proto::status>::type>(code);
+    BOOST_ASSERT(n >= first_code && n <= last_code);
+    auto const& head = pages_[n - first_code].head;
+
+    scratch.clear();
+    if(code == http_proto::status::not_found)
+    {
+        scratch += "<p>The requested URL ";
+        scratch += req.target_text();
+        scratch += " was not found on this server.</p>\n";
+    }
+    if(show_address_)
+    {
+        scratch += "<hr>\n";
+        scratch += "<address>Boost.Http.IO/1.0b (Win10) Server at ";
+        auto rv = urls::parse_authority(
+            req.value_or(http_proto::field::host, ""));
+        if(rv.has_value())
+        {
+            scratch += rv->host_address();
+            scratch += " Port ";
+            scratch += rv->port();
+        }
+        scratch += "</address>\n";
+    }
+
+    std::array<buffers::const_buffer, 3> body = {{
+        { head.data(), head.size() },
+        { scratch.data(), scratch.size() },
+        { tail_.data(), tail_.size() } }};
+
+    res.set_start_line(code, res.version());
+    res.set_keep_alive(
+        keep_alive &&
+        code != http_proto::status::service_unavailable &&
+        req.keep_alive());
+    res.set_payload_size(
+        head.size() + scratch.size() + tail_.size());
+    res.append(http_proto::field::content_type,
+        "text/html; charset=iso-8859-1");
+    res.append(http_proto::field::server,
+        "Boost.Http.IO/1.0b (Win10)");
+
+    sr.start(res, std::move(body));
+}
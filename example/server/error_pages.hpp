@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_ERROR_PAGES_HPP
+#define BOOST_HTTP_IO_EXAMPLE_ERROR_PAGES_HPP
+
+#include <boost/http_proto/request_view.hpp>
+#include <boost/http_proto/response.hpp>
+#include <boost/http_proto/serializer.hpp>
+#include <boost/http_proto/status.hpp>
+#include <string>
+
+/** A cache of prebuilt HTML error pages
+
+    The static portion of every 4xx and 5xx
+    page is rendered once at construction.
+    Responses reference the cached text directly
+    as an immutable buffer sequence, so the only
+    per-request work is the optional address
+    footer and the target of a 404.
+
+    The object must outlive every serializer
+    which was started with one of its pages.
+*/
+class error_pages
+{
+public:
+    /** Constructor
+
+        @param show_address If `true`, pages end with
+        the host and port taken from the request.
+    */
+    explicit
+    error_pages(bool show_address = false);
+
+    /** Prepare a response carrying a cached error page
+
+        @param code The status code, which must be 4xx or 5xx.
+
+        @param scratch Caller-owned storage for the dynamic
+        part of the body. It must remain unmodified until
+        the serializer is done.
+
+        @param keep_alive `false` if the connection must
+        close after this response regardless of the request.
+    */
+    void
+    start(
+        boost::http_proto::status code,
+        boost::http_proto::request_view const& req,
+        boost::http_proto::response& res,
+        boost::http_proto::serializer& sr,
+        std::string& scratch,
+        bool keep_alive = true) const;
+
+private:
+    struct page
+    {
+        // doctype through </h1>
+        std::string head;
+    };
+
+    static constexpr unsigned first_code = 400;
+    static constexpr unsigned last_code = 599;
+
+    page pages_[last_code - first_code + 1];
+    std::string tail_;
+    bool show_address_;
+};
+
+#endif
@@ -9,25 +9,39 @@
 
 #include "fixed_array.hpp"
 
+#include "access_log.hpp"
 #include "acceptor.hpp"
+#include "buffer_pool.hpp"
+#include "error_pages.hpp"
+#include "metrics.hpp"
+#include "proxy.hpp"
+#include "router.hpp"
 #include "server.hpp"
+#include "timer_wheel.hpp"
 
+#include <boost/asio/buffer.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/buffers/buffer_size.hpp>
+#include <boost/buffers/const_buffer.hpp>
 #include <boost/http_io.hpp>
 #include <boost/http_proto.hpp>
 #include <boost/url.hpp>
 #include <boost/core/detail/string_view.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 //-----------------------------------------------
 
-//#define LOGGING
-
 namespace io = boost::http_io;
 namespace urls = boost::urls;
 namespace asio = boost::asio;
+namespace buffers = boost::buffers;
 namespace core = boost::core;
 namespace http_proto = boost::http_proto;
 using namespace std::placeholders;
@@ -97,6 +111,26 @@ mime_type(
     return "application/text";
 }
 
+// Parse "address:port", with IPv6 addresses in brackets
+tcp::endpoint
+parse_endpoint(
+    core::string_view s)
+{
+    auto const pos = s.rfind(':');
+    if(pos == core::string_view::npos)
+        throw std::invalid_argument(
+            "expected address:port");
+    auto host = s.substr(0, pos);
+    if( host.size() >= 2 &&
+        host.front() == '[' &&
+        host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+    return tcp::endpoint(
+        asio::ip::make_address(std::string(host)),
+        static_cast<unsigned short>(std::atoi(
+            std::string(s.substr(pos + 1)).c_str())));
+}
+
 // Append an HTTP rel-path to a local filesystem path.
 // The returned path is normalized for the platform.
 void
@@ -130,210 +164,123 @@ path_cat(
 
 //------------------------------------------------
 
+// Serve files below the document root. The route
+// must capture the requested path as "path".
 class file_handler
 {
     std::string doc_root_;
+    error_pages const& pages_;
 
 public:
     file_handler(
-        core::string_view doc_root)
+        core::string_view doc_root,
+        error_pages const& pages)
         : doc_root_(doc_root)
+        , pages_(pages)
     {
     }
 
     void
     operator()(
+        route_params const& params,
         http_proto::request_view const& req,
         http_proto::response& res,
         http_proto::serializer& sr) const
     {
-        (void)req;
-        (void)res;
-        (void)sr;
-    }
+        auto& scratch = *params.scratch;
+        auto const keep_alive = params.keep_alive;
+
+        // Request path must not contain "..".
+        auto const target = params["path"];
+        if(target.find("..") != core::string_view::npos)
+            return pages_.start(
+                http_proto::status::bad_request,
+                    req, res, sr, scratch, keep_alive);
+
+        // Build the path to the requested file
+        std::string rel("/");
+        rel.append(target.data(), target.size());
+        std::string path;
+        path_cat(path, doc_root_, rel);
+        if(rel.back() == '/')
+            path.append("index.html");
+
+        // Attempt to open the file
+        boost::system::error_code ec;
+        http_proto::file f;
+        std::uint64_t size = 0;
+        f.open(path.c_str(), http_proto::file_mode::scan, ec);
+        if(! ec.failed())
+            size = f.size(ec);
+        if(! ec.failed())
+        {
+            res.set_start_line(
+                http_proto::status::ok,
+                req.version());
+            res.set(http_proto::field::server, "Boost");
+            res.set_keep_alive(keep_alive && req.keep_alive());
+            res.set_payload_size(size);
+
+            auto mt = mime_type(get_extension(path));
+            res.append(
+                http_proto::field::content_type, mt);
+
+            sr.start<http_proto::file_body>(
+                res, std::move(f), size);
+            return;
+        }
 
-private:
+        // ec.message()?
+        return pages_.start(
+            http_proto::status::internal_server_error,
+                req, res, sr, scratch, keep_alive);
+    }
 };
 
 //------------------------------------------------
 
-void
-make_error_response(
-    http_proto::status code,
-    http_proto::request_view const& req,
-    http_proto::response& res,
-    http_proto::serializer& sr)
+// Serve the scraped metrics as text
+class metrics_handler
 {
-    auto rv = urls::parse_authority(
-        req.value_or(http_proto::field::host, ""));
-    core::string_view host;
-    if(rv.has_value())
-        host = rv->buffer();
-    else
-        host = "";
-
-    std::string s;
-    s  = "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\n";
-    s += "<html><head>\n";
-    s += "<title>";
-        s += std::to_string(static_cast<
-            std::underlying_type<
-                http_proto::status>::type>(code));
-        s += " ";
-        s += http_proto::obsolete_reason(code);
-        s += "</title>\n";
-    s += "</head><body>\n";
-    s += "<h1>";
-        s += http_proto::obsolete_reason(code);
-        s += "</h1>\n";
-    if(code == http_proto::status::not_found)
-    {
-        s += "<p>The requested URL ";
-        s += req.target_text();
-        s += " was not found on this server.</p>\n";
-    }
-    s += "<hr>\n";
-    s += "<address>Boost.Http.IO/1.0b (Win10) Server at ";
-        s += rv->host_address();
-        s += " Port ";
-        s += rv->port();
-        s += "</address>\n";
-    s += "</body></html>\n";
-
-    res.set_start_line(code, res.version());
-    res.set_keep_alive(req.keep_alive());
-    res.set_payload_size(s.size());
-    res.append(http_proto::field::content_type,
-        "text/html; charset=iso-8859-1");
-    res.append(http_proto::field::date,
-        "Mon, 12 Dec 2022 03:26:32 GMT");
-    res.append(http_proto::field::server,
-        "Boost.Http.IO/1.0b (Win10)");
-
-    sr.start(
-        res,
-        http_proto::string_body(
-            std::move(s)));
-}
-
-//------------------------------------------------
+    server_metrics const& metrics_;
 
-void
-handle_request(
-    core::string_view doc_root,
-    http_proto::request_view const& req,
-    http_proto::response& res,
-    http_proto::serializer& sr)
-{
-#if 0
-    // Returns a server error response
-    auto const server_error =
-    [&req](beast::string_view what)
-    {
-        http::response<http::string_body> res{http::status::internal_server_error, req.version()};
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.set(http::field::content_type, "text/html");
-        res.keep_alive(req.keep_alive());
-        res.body() = "An error occurred: '" + std::string(what) + "'";
-        res.prepare_payload();
-        return res;
-    };
-#endif
+public:
+    explicit
+    metrics_handler(
+        server_metrics const& metrics)
+        : metrics_(metrics)
+    {
+    }
 
-    // Request path must be absolute and not contain "..".
-    if( req.target_text().empty() ||
-        req.target_text()[0] != '/' ||
-        req.target_text().find("..") != core::string_view::npos)
-        return make_error_response(
-            http_proto::status::bad_request, req, res, sr);
-
-    // Build the path to the requested file
-    std::string path; 
-    path_cat(path, doc_root, req.target_text());
-    if(req.target_text().back() == '/')
-        path.append("index.html");
-
-    // Attempt to open the file
-    boost::system::error_code ec;
-    http_proto::file f;
-    std::uint64_t size = 0;
-    f.open(path.c_str(), http_proto::file_mode::scan, ec);
-    if(! ec.failed())
-        size = f.size(ec);
-    if(! ec.failed())
+    void
+    operator()(
+        route_params const& params,
+        http_proto::request_view const& req,
+        http_proto::response& res,
+        http_proto::serializer& sr) const
     {
+        auto& scratch = *params.scratch;
+        scratch.clear();
+        metrics_.render(scratch);
+
         res.set_start_line(
             http_proto::status::ok,
             req.version());
         res.set(http_proto::field::server, "Boost");
-        res.set_keep_alive(req.keep_alive());
-        res.set_payload_size(size);
-
-        auto mt = mime_type(get_extension(path));
+        res.set_keep_alive(params.keep_alive && req.keep_alive());
+        res.set_payload_size(scratch.size());
         res.append(
-            http_proto::field::content_type, mt);
-
-        sr.start<http_proto::file_body>(
-            res, std::move(f), size);
-        return;
+            http_proto::field::content_type,
+            "text/plain; version=0.0.4");
+
+        // Routed here for HEAD too, which gets
+        // the header of the GET response only
+        if(req.method() == http_proto::method::head)
+            return sr.start(res);
+        sr.start(res, buffers::const_buffer(
+            scratch.data(), scratch.size()));
     }
-
-    // ec.message()?
-    return make_error_response(
-        http_proto::status::internal_server_error,
-            req, res, sr);
-}
-
-//------------------------------------------------
-
-void
-service_unavailable(
-    http_proto::request_view const& req,
-    http_proto::response& res,
-    http_proto::serializer& sr)
-{
-    auto const code = http_proto::status::service_unavailable;
-    auto rv = urls::parse_authority( req.value_or( http_proto::field::host, "" ) );
-    core::string_view host;
-    if(rv.has_value())
-        host = rv->buffer();
-    else
-        host = "";
-
-    std::string s;
-    s  = "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\n";
-    s += "<html><head>\n";
-    s += "<title>";
-        s += std::to_string(static_cast<
-            std::underlying_type<
-                http_proto::status>::type>(code));
-        s += " ";
-        s += http_proto::obsolete_reason(code);
-        s += "</title>\n";
-    s += "</head><body>\n";
-    s += "<h1>";
-        s += http_proto::obsolete_reason(code);
-        s += "</h1>\n";
-    s += "<hr>\n";
-    s += "<address>Boost.Http.IO/1.0b (Win10) Server at ";
-        s += rv->host_address();
-        s += " Port ";
-        s += rv->port();
-        s += "</address>\n";
-    s += "</body></html>\n";
-
-    res.set_start_line(code, res.version());
-    res.set_keep_alive(false);
-    res.set_payload_size(s.size());
-    res.append(http_proto::field::content_type, "text/html; charset=iso-8859-1");
-    //res.append(http_proto::field::date, "Mon, 12 Dec 2022 03:26:32 GMT" );
-    res.append(http_proto::field::server, "Boost.Http.Io");
-
-    sr.start(
-        res,
-        http_proto::string_body(
-            std::move(s)));
-}
+};
 
 //------------------------------------------------
 
@@ -342,29 +289,63 @@ class worker
 {
 public:
     using acceptor_type = acceptor< Executor >;
+    using clock_type = std::chrono::steady_clock;
+
+    // most responses sent in one write
+    static constexpr std::size_t max_pipeline = 8;
 
 private:
+    // A response in the current batch. The request
+    // line is copied for the log because the parser
+    // moves on to the next request before it is sent.
+    struct pending
+    {
+        http_proto::response res;
+        buffer_pool::serializer_ptr sr;
+        std::string scratch;
+        std::string method;
+        std::string target;
+        clock_type::time_point received;
+        std::size_t prepared = 0;
+        std::uint64_t bytes = 0;
+    };
+
     // order of destruction matters here
+    server& srv_;
     acceptor_type& ac_;
     typename acceptor_type::socket_type sock_;
-    std::string const& doc_root_;
-    http_proto::request_parser pr_;
-    http_proto::response res_;
-    http_proto::serializer sr_;
+    buffer_pool::parser_ptr pr_;
+    pending q_[max_pipeline];
+    std::size_t nq_ = 0;
+    std::size_t used_ = 0; // slots filled since parked
+    std::vector<asio::const_buffer> bufs_;
+    timer_wheel::timer deadline_;
+    std::unique_ptr<proxy::exchange> px_;
+    clock_type::time_point started_;
+    clock_type::time_point received_;
+    boost::system::error_code ahead_ec_;
+    std::uint64_t unparsed_ = 0;
+    std::size_t room_ = 0; // input space of an empty parser
     std::size_t id_ = 0;
+    std::size_t admitted_ = 0;
+    bool timed_out_ = false;
+    bool is_unframed_ = false;
+    bool is_ahead_ = false;
+    bool is_stopped_ = false;
+    bool is_connected_ = false;
+    bool is_idle_ = false;
 
 public:
     worker(
         server& srv,
-        acceptor_type& ac,
-        std::string const& doc_root)
-        : ac_(ac)
+        acceptor_type& ac)
+        : srv_(srv)
+        , ac_(ac)
         , sock_(srv.make_executor())
-        , doc_root_(doc_root)
-        , pr_(ac_.context())
-        , sr_(ac_.context(), 65536)
+        , deadline_(std::bind(&worker::on_timeout, this))
         , id_(ac_.next_id())
     {
+        bufs_.reserve(max_pipeline * 4);
     }
 
     void
@@ -373,9 +354,25 @@ public:
         do_accept();
     }
 
+    // Close the connection if it is waiting for
+    // a request. Busy connections close after
+    // sending their current response.
+    void
+    drain()
+    {
+        if(! is_idle_)
+            return;
+        boost::system::error_code ec;
+        sock_.cancel(ec);
+    }
+
     void
     stop()
     {
+        is_stopped_ = true;
+        deadline_.cancel();
+        if(px_)
+            px_->cancel();
         boost::system::error_code ec;
         sock_.cancel(ec);
     }
@@ -383,11 +380,15 @@ public:
 private:
     void
     fail(
-        std::string what,
+        char const* what,
         boost::system::error_code ec)
     {
         if( ec == asio::error::operation_aborted )
-            return;
+        {
+            if(! timed_out_)
+                return;
+            ec = asio::error::timed_out;
+        }
 
         if( ec == asio::error::eof )
         {
@@ -396,11 +397,110 @@ private:
             return;
         }
 
-    #ifdef LOGGING
-        std::cerr <<
-            what << "[" << id_ << "]: " <<
-            ec.message() << "\n";
-    #endif
+        ac_.log().error(id_, what, ec);
+    }
+
+    // Arm the deadline for the next phase
+    // of the connection, replacing the last.
+    void
+    expires_after(
+        timer_wheel::duration d)
+    {
+        ac_.timers().arm(deadline_, d);
+    }
+
+    // Release the admission slots, if any
+    void
+    end_request() noexcept
+    {
+        for(; admitted_ > 0; --admitted_)
+            ac_.admit().end();
+    }
+
+    // Account for the bytes of a complete request,
+    // leaving in `unparsed_` those read beyond it.
+    void
+    consume(
+        http_proto::request_view const& req) noexcept
+    {
+        std::uint64_t n = req.buffer().size();
+        if(req.payload() == http_proto::payload::size)
+            n += req.payload_size();
+        else if(req.payload() != http_proto::payload::none)
+            is_unframed_ = true; // chunked, size unknown
+        unparsed_ -= (std::min)(n, unparsed_);
+    }
+
+    // Start the parser on the bytes read beyond the
+    // previous request. After a chunked request their
+    // number is unknown, so it is measured once the
+    // parser has kept them: they take that much of
+    // the input space an empty parser offers.
+    void
+    start_ahead()
+    {
+        pr_->start();
+        if(! is_unframed_)
+            return;
+        unparsed_ = room_ -
+            buffers::buffer_size(pr_->prepare());
+        is_unframed_ = false;
+    }
+
+    // Begin the next response of the batch
+    pending&
+    next_slot()
+    {
+        auto& s = q_[nq_++];
+        used_ = (std::max)(used_, nq_);
+        if(! s.sr)
+            s.sr = ac_.pool().acquire_serializer();
+        s.res.clear();
+        s.prepared = 0;
+        s.bytes = 0;
+        auto const& req = pr_->get();
+        s.method.assign(
+            req.method_text().data(),
+            req.method_text().size());
+        s.target.assign(
+            req.target_text().data(),
+            req.target_text().size());
+        s.received = received_;
+        return s;
+    }
+
+    // Give back the serializers while parked. The
+    // slots past the first are only filled by a
+    // pipelined batch, so their heap storage goes
+    // too. An idle connection then holds the first
+    // slot's response and strings, each sized by
+    // the largest request seen, and the room for
+    // max_pipeline * 4 buffers in `bufs_`.
+    void
+    release_slots() noexcept
+    {
+        for(auto& s : q_)
+            ac_.pool().release(s.sr);
+        for(std::size_t i = 1; i < used_; ++i)
+        {
+            auto& s = q_[i];
+            s.res = http_proto::response();
+            std::string().swap(s.scratch);
+            std::string().swap(s.method);
+            std::string().swap(s.target);
+        }
+        nq_ = 0;
+        used_ = 0;
+    }
+
+    void
+    on_timeout()
+    {
+        // The pending operation completes
+        // with operation_aborted.
+        timed_out_ = true;
+        boost::system::error_code ec;
+        sock_.cancel(ec);
     }
 
     void
@@ -408,8 +508,25 @@ private:
     {
         // Clean up any previous connection.
         boost::system::error_code ec;
+        end_request();
+        deadline_.cancel();
+        timed_out_ = false;
         sock_.close(ec);
-        pr_.reset();
+        ac_.pool().release(pr_);
+        release_slots();
+        unparsed_ = 0;
+        is_unframed_ = false;
+        is_ahead_ = false;
+        if(is_connected_)
+        {
+            is_connected_ = false;
+            srv_.remove_connection();
+            ac_.metrics().local().active.add(-1);
+        }
+
+        // Draining, no new connections
+        if(ac_.is_shutting_down())
+            return;
 
         ac_.socket().async_accept( sock_,
             std::bind(&worker::on_accept, this, _1));
@@ -421,24 +538,107 @@ private:
         if( ec.failed() )
         {
             fail("async_accept", ec);
-            if( ec == asio::error::operation_aborted )
+            if( is_stopped_ )
                 return;
             return do_accept();
         }
 
-        // Request must be fully processed within 60 seconds.
-        //request_deadline_.expires_after(
-            //std::chrono::seconds(60));
+        // Overloaded, refuse the connection
+        // rather than queue more work.
+        if(! ac_.admit().accepting())
+        {
+            ac_.admit().refuse();
+            return do_accept();
+        }
+
+        is_connected_ = true;
+        srv_.add_connection();
+        auto& m = ac_.metrics().local();
+        m.accepts.add();
+        m.active.add(1);
 
+        pr_ = ac_.pool().acquire_parser();
         do_read();
     }
 
     void
     do_read()
     {
-        pr_.start();
+        pr_->start();
+        if(room_ == 0)
+            room_ = buffers::buffer_size(pr_->prepare());
+
+        started_ = clock_type::now();
+        expires_after(ac_.timeouts().header);
+        io::async_read_header(sock_, *pr_, std::bind(
+            &worker::on_read_header, this, _1, _2));
+    }
+
+    // Wait for the next request on a
+    // keep-alive connection.
+    void
+    do_idle()
+    {
+        started_ = clock_type::now();
+
+        // The next request may already be
+        // buffered if the client pipelines.
+        if( ! is_ahead_ &&
+            (unparsed_ != 0 || is_unframed_))
+        {
+            start_ahead();
+            if(unparsed_ != 0)
+            {
+                pr_->parse(ahead_ec_);
+                is_ahead_ = true;
+            }
+        }
+        if( is_ahead_ &&
+            ahead_ec_ != http_proto::condition::need_more_input)
+        {
+            is_ahead_ = false;
+            return on_read_header(ahead_ec_, 0);
+        }
+
+        // Draining, close instead of waiting
+        if(ac_.is_shutting_down())
+            return do_accept();
+
+        // Give the buffers back while parked, keeping
+        // the parser only if it holds a partial request.
+        release_slots();
+        if(! is_ahead_)
+            ac_.pool().release(pr_);
+        is_ahead_ = false;
+
+        is_idle_ = true;
+        expires_after(ac_.timeouts().idle);
+        sock_.async_wait(
+            asio::socket_base::wait_read,
+            std::bind(&worker::on_idle, this, _1));
+    }
+
+    void
+    on_idle(boost::system::error_code ec)
+    {
+        is_idle_ = false;
+        if(ec.failed())
+        {
+            fail("async_wait", ec);
+            if(is_stopped_)
+                return;
+            return do_accept();
+        }
 
-        io::async_read_header(sock_, pr_, std::bind(
+        if(! pr_)
+        {
+            pr_ = ac_.pool().acquire_parser();
+            pr_->start();
+        }
+
+        started_ = clock_type::now();
+        expires_after(ac_.timeouts().header);
+        io::async_read_header(sock_, *pr_, std::bind(
             &worker::on_read_header, this, _1, _2));
     }
 
@@ -447,78 +647,313 @@ private:
         boost::system::error_code ec,
         std::size_t bytes_transferred)
     {
-        (void)bytes_transferred;
-
         if(ec.failed())
         {
             fail("async_read_header", ec);
-            if(ec == asio::error::operation_aborted)
+            if(is_stopped_)
                 return;
             return do_accept();
         }
 
-        io::async_read(sock_, pr_, std::bind(
+        auto& m = ac_.metrics().local();
+        auto const now = clock_type::now();
+        m.header_read.record(now - started_);
+        m.bytes_in.add(bytes_transferred);
+        unparsed_ += bytes_transferred;
+
+        // Shed load before reading the body
+        if(! begin_request(now))
+        {
+            ac_.pages().start(
+                http_proto::status::service_unavailable,
+                pr_->get(), q_[0].res, *q_[0].sr,
+                q_[0].scratch);
+            return do_write();
+        }
+
+        // Forward to an upstream, streaming the body
+        auto const px = ac_.get_proxy();
+        if(px && px->matches(pr_->get()))
+            return do_proxy();
+
+        do_read_body();
+    }
+
+    // Read the body in pieces, re-arming the deadline
+    // for each so that it limits the time without
+    // progress, not the time taken by the whole body.
+    void
+    do_read_body()
+    {
+        expires_after(ac_.timeouts().body);
+        io::async_read_some(sock_, *pr_, std::bind(
             &worker::on_read_body, this, _1, _2));
     }
 
+    // Count a request whose header is parsed and take
+    // an admission slot for it. Returns `false` with
+    // a slot started if the request must be shed.
+    bool
+    begin_request(
+        clock_type::time_point now)
+    {
+        ac_.metrics().local().requests.add();
+        received_ = now;
+        if(! ac_.admit().try_begin())
+        {
+            next_slot();
+            return false;
+        }
+        ++admitted_;
+        return true;
+    }
+
     void
-    on_read_body(
+    do_proxy()
+    {
+        if(! px_)
+            px_.reset(new proxy::exchange(
+                *ac_.get_proxy(), sock_, deadline_,
+                ac_.timeouts().body, ac_.timeouts().write,
+                std::bind(&worker::on_proxy, this, _1, _2)));
+
+        // The exchange arms the deadline around
+        // each client operation, never while it
+        // waits on the upstream.
+        auto& s = next_slot();
+        started_ = clock_type::now();
+        deadline_.cancel();
+        px_->start(*pr_, s.res, *s.sr,
+            ! ac_.is_shutting_down());
+    }
+
+    void
+    on_proxy(
         boost::system::error_code ec,
         std::size_t bytes_transferred)
     {
-        (void)bytes_transferred;
+        ac_.metrics().local().bytes_in.add(
+            px_->bytes_read());
+        unparsed_ += px_->bytes_read();
+        if(! ec.failed())
+            consume(pr_->get());
+        q_[0].bytes = bytes_transferred;
+        on_written(ec);
+    }
 
+    void
+    on_read_body(
+        boost::system::error_code ec,
+        std::size_t bytes_transferred)
+    {
         if( ec.failed() )
         {
-            fail("async_read", ec);
-            if( ec == asio::error::operation_aborted )
+            fail("async_read_some", ec);
+            if( is_stopped_ )
                 return;
             return do_accept();
         }
 
-        res_.clear();
+        ac_.metrics().local().bytes_in.add(
+            bytes_transferred);
+        unparsed_ += bytes_transferred;
+        if(! pr_->is_complete())
+            return do_read_body();
+        respond();
+        read_ahead();
+        do_write();
+    }
+
+    // Dispatch the complete request in the parser
+    void
+    respond()
+    {
+        consume(pr_->get());
+        auto const t0 = clock_type::now();
+        auto& s = next_slot();
+
+        // Requests in flight during a graceful
+        // shutdown are served with Connection: close
+        route_params params;
+        params.scratch = &s.scratch;
+        params.keep_alive = ! ac_.is_shutting_down();
+        auto const code = ac_.routes().dispatch(
+            params, pr_->get(), s.res, *s.sr);
+        if(code == http_proto::status::method_not_allowed)
+            s.res.set(http_proto::field::allow, params.allow);
+        if(code != http_proto::status::ok)
+            ac_.pages().start(code, pr_->get(), s.res,
+                *s.sr, s.scratch, params.keep_alive);
+
+        ac_.metrics().local().handler.record(
+            clock_type::now() - t0);
+    }
 
-        if(! ac_.is_shutting_down())
+    // Respond to requests a pipelining client has
+    // already sent, so that their responses go out
+    // in the same write. Stops at the first request
+    // which is not entirely buffered, leaving it in
+    // the parser for @ref do_idle.
+    void
+    read_ahead()
+    {
+        while(nq_ < max_pipeline)
         {
-            handle_request(
-                doc_root_,
-                pr_.get(),
-                res_,
-                sr_);
+            if( ! q_[nq_ - 1].res.keep_alive() ||
+                (unparsed_ == 0 && ! is_unframed_))
+                return;
+
+            start_ahead();
+            if(unparsed_ == 0)
+                return;
+            pr_->parse(ahead_ec_);
+            is_ahead_ = true;
+            if(ahead_ec_.failed())
+                return;
+
+            auto const px = ac_.get_proxy();
+            if(px && px->matches(pr_->get()))
+                return;
+            if(! pr_->is_complete())
+            {
+                boost::system::error_code ec;
+                pr_->parse(ec);
+                if(! pr_->is_complete())
+                    return;
+            }
+
+            is_ahead_ = false;
+            if(! begin_request(clock_type::now()))
+            {
+                auto& s = q_[nq_ - 1];
+                consume(pr_->get());
+                ac_.pages().start(
+                    http_proto::status::service_unavailable,
+                    pr_->get(), s.res, *s.sr, s.scratch);
+                continue;
+            }
+            respond();
         }
-        else
+    }
+
+    void
+    do_write()
+    {
+        started_ = clock_type::now();
+        write_some();
+    }
+
+    // Gather the output of every response in the
+    // batch into one vectored write. A response
+    // may only follow another whose remaining
+    // output is entirely prepared.
+    void
+    write_some()
+    {
+        bufs_.clear();
+        for(std::size_t i = 0; i < nq_; ++i)
         {
-            service_unavailable(pr_.get(), res_, sr_);
+            auto& s = q_[i];
+            s.prepared = 0;
+            if(s.sr->is_done())
+                continue;
+            auto rv = s.sr->prepare();
+            if(rv.has_error())
+                return on_written(rv.error());
+            for(auto const& b : *rv)
+            {
+                bufs_.emplace_back(b.data(), b.size());
+                s.prepared += b.size();
+            }
+            if(! is_prepared(s))
+                break;
         }
+        // Re-armed on each write, like the body
+        // deadline, to limit time without progress
+        expires_after(ac_.timeouts().write);
+        sock_.async_write_some(bufs_, std::bind(
+            &worker::on_write_some, this, _1, _2));
+    }
 
-    #ifdef LOGGING
-        std::cerr << 
-            pr_.get().buffer() <<
-            res_.buffer() <<
-            "--------------------------------------------------\n";
-    #endif
-
-        io::async_write(sock_, sr_, std::bind(
-            &worker::on_write, this, _1, _2));
+    // Return true if the prepared bytes are all
+    // that remain of the response. Only sized
+    // bodies qualify.
+    static
+    bool
+    is_prepared(pending const& s) noexcept
+    {
+        std::uint64_t n = s.res.buffer().size();
+        if(s.res.payload() == http_proto::payload::size)
+            n += s.res.payload_size();
+        else if(s.res.payload() != http_proto::payload::none)
+            return false;
+        return s.bytes + s.prepared == n;
     }
 
     void
-    on_write(
+    on_write_some(
         boost::system::error_code ec,
         std::size_t bytes_transferred)
     {
-        (void)bytes_transferred;
+        if(ec.failed())
+            return on_written(ec);
 
+        for(std::size_t i = 0; i < nq_; ++i)
+        {
+            auto& s = q_[i];
+            auto const n = (std::min)(
+                s.prepared, bytes_transferred);
+            if(n == 0)
+                continue;
+            s.sr->consume(n);
+            s.bytes += n;
+            bytes_transferred -= n;
+        }
+
+        for(std::size_t i = 0; i < nq_; ++i)
+            if(! q_[i].sr->is_done())
+                return write_some();
+        on_written({});
+    }
+
+    void
+    on_written(boost::system::error_code ec)
+    {
         if( ec.failed() )
         {
             fail("async_write", ec);
-            if( ec == asio::error::operation_aborted )
+            if( is_stopped_ )
                 return;
             return do_accept();
         }
 
-        if(res_.keep_alive())
-            return do_read();
+        auto& m = ac_.metrics().local();
+        auto const now = clock_type::now();
+        for(std::size_t i = 0; i < nq_; ++i)
+        {
+            auto const& s = q_[i];
+            m.bytes_out.add(s.bytes);
+            m.write.record(now - started_);
+            auto const status_class = s.res.status_int() / 100;
+            if(status_class >= 1 && status_class <= 5)
+                m.status[status_class - 1].add();
+
+            ac_.log().access(
+                id_,
+                s.method,
+                s.target,
+                s.res.status_int(),
+                s.bytes,
+                now - s.received);
+        }
+
+        end_request();
+
+        auto const keep_alive =
+            q_[nq_ - 1].res.keep_alive();
+        nq_ = 0;
+        if(keep_alive)
+            return do_idle();
 
         do_accept();
     }
@@ -530,10 +965,35 @@ int main(int argc, char* argv[])
 {
     try
     {
+        // Options come before the positional arguments
+        admission::limits limits;
+        int n = 1;
+        for(; n < argc && core::string_view(argv[n]).starts_with("--"); ++n)
+        {
+            core::string_view const opt = argv[n];
+            auto const value = std::string(opt.substr(opt.find('=') + 1));
+            if(opt.starts_with("--max-in-flight="))
+                limits.max_in_flight = std::stoul(value);
+            else if(opt.starts_with("--target-delay-ms="))
+                limits.target = std::chrono::milliseconds(std::stoul(value));
+            else
+                throw std::invalid_argument(
+                    "unknown option " + std::string(opt));
+        }
+        argv[n - 1] = argv[0];
+        argv += n - 1;
+        argc -= n - 1;
+
         // Check command line arguments.
-        if (argc != 5)
+        if (argc < 5 || argc == 8)
         {
-            std::cerr << "Usage: http_server_async <address> <port> <doc_root> <num_workers>\n";
+            std::cerr << "Usage: http_server_async [<options>] <address> <port> <doc_root> <num_workers> [<metrics_path> [<log_file> [<proxy_prefix> <upstream>...]]]\n";
+            std::cerr << "  Options:\n";
+            std::cerr << "    --max-in-flight=<n>       Requests admitted at once, 0 for no limit\n";
+            std::cerr << "    --target-delay-ms=<ms>    Queueing delay above which requests are shed\n";
+            std::cerr << "  Use \"-\" as the log file for standard error\n";
+            std::cerr << "  Requests starting with <proxy_prefix> are forwarded to the\n";
+            std::cerr << "  <upstream> servers, each given as address:port\n";
             std::cerr << "  For IPv4, try:\n";
             std::cerr << "    http_server_async 0.0.0.0 80 . 100\n";
             std::cerr << "  For IPv6, try:\n";
@@ -545,10 +1005,23 @@ int main(int argc, char* argv[])
         unsigned short const port = static_cast<unsigned short>(std::atoi(argv[2]));
         std::string const doc_root = argv[3];
         std::size_t num_workers = std::atoi(argv[4]);
+        std::string const metrics_path =
+            argc >= 6 ? argv[5] : "/metrics";
+        std::string const log_file =
+            argc >= 7 ? argv[6] : "";
 
         using executor_type = asio::io_context::executor_type;
 
-        file_handler fh(doc_root);
+        // The pages are built once here and shared,
+        // so error responses never allocate.
+        error_pages pages;
+        server_metrics metrics;
+
+        router routes;
+        routes.add(http_proto::method::get,
+            metrics_path, metrics_handler(metrics));
+        routes.add("/*path", file_handler(doc_root, pages));
+        routes.freeze();
 
         http_proto::context ctx;
         {
@@ -557,12 +1030,37 @@ int main(int argc, char* argv[])
         }
 
         server srv;
+        auto& timers = srv.make_service<timer_wheel>(srv);
+        auto& admit = srv.make_service<admission>(srv);
+        admit.get_limits() = limits;
+        metrics.add_collector([&admit](std::string& dest)
+            {
+                admit.append_metrics(dest);
+            });
+        auto& log = srv.make_service<access_log>(log_file);
+
+        proxy* px = nullptr;
+        if(argc > 8)
+        {
+            proxy::config cfg;
+            cfg.prefix = argv[7];
+            for(int i = 8; i < argc; ++i)
+                cfg.upstreams.push_back(parse_endpoint(argv[i]));
+            px = &srv.make_service<proxy>(
+                srv, ctx, pages, timers, std::move(cfg));
+        }
         srv.make_service<acceptor<executor_type>>(
             srv,
             tcp::endpoint(addr, port),
             ctx,
-            num_workers,
-            doc_root );
+            pages,
+            timers,
+            admit,
+            metrics,
+            log,
+            routes,
+            px,
+            num_workers );
 
         srv.run();
     }
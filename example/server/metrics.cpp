@@ -0,0 +1,244 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "metrics.hpp"
+#include <array>
+#include <cstdio>
+
+namespace {
+
+using counts = std::array<
+    std::uint64_t, server_metrics::histogram::size>;
+
+struct merged
+{
+    counts buckets{};
+    std::uint64_t sum = 0;
+    std::uint64_t count = 0;
+};
+
+void
+append_number(std::string& dest, std::uint64_t v)
+{
+    dest.append(std::to_string(v));
+}
+
+void
+append_seconds(std::string& dest, std::uint64_t us)
+{
+    char buf[32];
+    auto const n = std::snprintf(buf, sizeof(buf),
+        "%.6f", static_cast<double>(us) / 1e6);
+    dest.append(buf, static_cast<std::size_t>(n));
+}
+
+// Histograms are exposed as summaries, since
+// the quantiles are exact to within a bucket
+// while hundreds of `le` buckets are not useful.
+void
+append_summary(
+    std::string& dest,
+    char const* name,
+    char const* help,
+    merged const& h)
+{
+    static constexpr char const* labels[] = {
+        "0.5", "0.9", "0.99", "0.999" };
+    static constexpr double quantiles[] = {
+        0.5, 0.9, 0.99, 0.999 };
+
+    dest.append("# HELP ").append(name).append(" ");
+    dest.append(help).append("\n# TYPE ");
+    dest.append(name).append(" summary\n");
+
+    std::size_t i = 0;
+    std::uint64_t seen = 0;
+    for(std::size_t q = 0; q < 4; ++q)
+    {
+        // rank of the quantile, 1-based
+        auto const rank = static_cast<std::uint64_t>(
+            quantiles[q] * static_cast<double>(h.count) + 0.5);
+        while(i < h.buckets.size() &&
+            (seen + h.buckets[i] < rank || h.buckets[i] == 0))
+            seen += h.buckets[i++];
+        dest.append(name).append("{quantile=\"");
+        dest.append(labels[q]).append("\"} ");
+        if(h.count == 0)
+            dest.append("NaN");
+        else
+            append_seconds(dest,
+                server_metrics::histogram::highest(
+                    i < h.buckets.size() ? i : i - 1));
+        dest.push_back('\n');
+    }
+
+    dest.append(name).append("_sum ");
+    append_seconds(dest, h.sum);
+    dest.append("\n").append(name).append("_count ");
+    append_number(dest, h.count);
+    dest.push_back('\n');
+}
+
+void
+merge(
+    merged& m,
+    counts const& buckets,
+    std::uint64_t sum)
+{
+    for(std::size_t i = 0; i < buckets.size(); ++i)
+    {
+        m.buckets[i] += buckets[i];
+        m.count += buckets[i];
+    }
+    m.sum += sum;
+}
+
+} // (anon)
+
+//------------------------------------------------
+
+void
+server_metrics::
+histogram::
+record(
+    std::chrono::steady_clock::duration d) noexcept
+{
+    auto const us = std::chrono::duration_cast<
+        std::chrono::microseconds>(d).count();
+    auto const v = us < 0 ? 0 :
+        static_cast<std::uint64_t>(us);
+    counts_[index(v)].add();
+    sum_.add(v);
+}
+
+//------------------------------------------------
+
+void
+server_metrics::
+append_counter(
+    std::string& dest,
+    char const* name,
+    char const* help,
+    std::uint64_t v)
+{
+    dest.append("# HELP ").append(name).append(" ");
+    dest.append(help).append("\n# TYPE ");
+    dest.append(name).append(" counter\n");
+    dest.append(name).append(" ");
+    append_number(dest, v);
+    dest.push_back('\n');
+}
+
+void
+server_metrics::
+append_gauge(
+    std::string& dest,
+    char const* name,
+    char const* help,
+    double v)
+{
+    char buf[32];
+    auto const n = std::snprintf(
+        buf, sizeof(buf), "%.9g", v);
+    dest.append("# HELP ").append(name).append(" ");
+    dest.append(help).append("\n# TYPE ");
+    dest.append(name).append(" gauge\n");
+    dest.append(name).append(" ");
+    dest.append(buf, static_cast<std::size_t>(n));
+    dest.push_back('\n');
+}
+
+void
+server_metrics::
+add_collector(collector c)
+{
+    collectors_.push_back(std::move(c));
+}
+
+void
+server_metrics::
+render(std::string& dest) const
+{
+    std::uint64_t accepts = 0;
+    std::uint64_t requests = 0;
+    std::uint64_t bytes_in = 0;
+    std::uint64_t bytes_out = 0;
+    std::uint64_t status[5] = {};
+    std::int64_t active = 0;
+    merged header_read;
+    merged handler;
+    merged write;
+
+    {
+        counts buckets;
+        auto const snapshot = [&buckets](
+            histogram const& h) -> std::uint64_t
+        {
+            for(std::size_t i = 0; i < buckets.size(); ++i)
+                buckets[i] = h.counts_[i].load();
+            return h.sum_.load();
+        };
+
+        shards_.for_each([&](shard const& s)
+        {
+            accepts += s.accepts.load();
+            requests += s.requests.load();
+            bytes_in += s.bytes_in.load();
+            bytes_out += s.bytes_out.load();
+            for(std::size_t i = 0; i < 5; ++i)
+                status[i] += s.status[i].load();
+            active += s.active.load();
+
+            auto sum = snapshot(s.header_read);
+            merge(header_read, buckets, sum);
+            sum = snapshot(s.handler);
+            merge(handler, buckets, sum);
+            sum = snapshot(s.write);
+            merge(write, buckets, sum);
+        });
+    }
+
+    append_counter(dest, "http_io_accepts_total",
+        "Connections accepted.", accepts);
+    append_counter(dest, "http_io_requests_total",
+        "Request headers received.", requests);
+    append_counter(dest, "http_io_received_bytes_total",
+        "Bytes read from connections.", bytes_in);
+    append_counter(dest, "http_io_sent_bytes_total",
+        "Bytes written to connections.", bytes_out);
+
+    dest.append(
+        "# HELP http_io_responses_total Responses sent by status class.\n"
+        "# TYPE http_io_responses_total counter\n");
+    for(std::size_t i = 0; i < 5; ++i)
+    {
+        dest.append("http_io_responses_total{class=\"");
+        dest.push_back(static_cast<char>('1' + i));
+        dest.append("xx\"} ");
+        append_number(dest, status[i]);
+        dest.push_back('\n');
+    }
+
+    dest.append(
+        "# HELP http_io_active_connections Connections currently open.\n"
+        "# TYPE http_io_active_connections gauge\n"
+        "http_io_active_connections ");
+    dest.append(std::to_string(active));
+    dest.push_back('\n');
+
+    append_summary(dest, "http_io_header_read_seconds",
+        "Time to receive a request header.", header_read);
+    append_summary(dest, "http_io_handler_seconds",
+        "Time spent producing a response.", handler);
+    append_summary(dest, "http_io_write_seconds",
+        "Time to send a response.", write);
+
+    for(auto const& c : collectors_)
+        c(dest);
+}
@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_METRICS_HPP
+#define BOOST_HTTP_IO_EXAMPLE_METRICS_HPP
+
+#include "../common/log_linear.hpp"
+#include "thread_shards.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** Server counters and latency histograms
+
+    Every thread which records a value gets its
+    own shard, so the hot path never contends:
+    each value has a single writer which updates
+    it with relaxed loads and stores. A scrape
+    merges all shards and renders them in the
+    Prometheus text exposition format.
+*/
+class server_metrics
+{
+public:
+    /** A monotonic counter with a single writer
+    */
+    class counter
+    {
+        std::atomic<std::uint64_t> v_{0};
+
+    public:
+        void
+        add(std::uint64_t n = 1) noexcept
+        {
+            v_.store(
+                v_.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+        }
+
+        std::uint64_t
+        load() const noexcept
+        {
+            return v_.load(std::memory_order_relaxed);
+        }
+    };
+
+    /** A gauge with a single writer
+    */
+    class gauge
+    {
+        std::atomic<std::int64_t> v_{0};
+
+    public:
+        void
+        add(std::int64_t n) noexcept
+        {
+            v_.store(
+                v_.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+        }
+
+        std::int64_t
+        load() const noexcept
+        {
+            return v_.load(std::memory_order_relaxed);
+        }
+    };
+
+    /** A log-linear histogram of microseconds
+
+        Each power of two is split into 16 linear
+        sub-buckets, bounding the relative error
+        of any value to 1/16.
+    */
+    class histogram : public log_linear<4>
+    {
+    public:
+        void
+        record(std::chrono::steady_clock::duration d) noexcept;
+
+    private:
+        friend class server_metrics;
+
+        counter counts_[size];
+        counter sum_;
+    };
+
+    struct shard
+    {
+        counter accepts;
+        counter requests;
+        counter bytes_in;
+        counter bytes_out;
+        counter status[5]; // 1xx through 5xx
+        gauge active;
+
+        histogram header_read;
+        histogram handler;
+        histogram write;
+    };
+
+    /** Return the shard of the calling thread
+    */
+    shard&
+    local()
+    {
+        return shards_.local();
+    }
+
+    using collector = std::function<void(std::string&)>;
+
+    /** Add a source of metrics kept outside the shards
+
+        Each collector appends its metrics to every
+        scrape, on the thread which calls @ref render.
+        Collectors must be added before the first scrape.
+    */
+    void
+    add_collector(collector c);
+
+    /** Render all shards in Prometheus text format
+    */
+    void
+    render(std::string& dest) const;
+
+    // Append one sample in Prometheus text format
+    static void
+    append_counter(
+        std::string& dest,
+        char const* name,
+        char const* help,
+        std::uint64_t v);
+
+    static void
+    append_gauge(
+        std::string& dest,
+        char const* name,
+        char const* help,
+        double v);
+
+private:
+    thread_shards<shard> shards_;
+    std::vector<collector> collectors_;
+};
+
+#endif
@@ -0,0 +1,685 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "proxy.hpp"
+#include <boost/http_io/read.hpp>
+#include <boost/http_io/write.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/buffers/buffer_copy.hpp>
+#include <boost/buffers/buffer_size.hpp>
+#include <boost/http_proto/error.hpp>
+#include <boost/url/grammar/ci_string.hpp>
+#include <stdexcept>
+
+namespace asio = boost::asio;
+namespace buffers = boost::buffers;
+namespace core = boost::core;
+namespace http_io = boost::http_io;
+namespace http_proto = boost::http_proto;
+namespace urls = boost::urls;
+using namespace std::placeholders;
+
+namespace {
+
+// Fields which only apply to one connection. RFC 9110
+// 7.6.1 names Connection, TE, Upgrade and the fields
+// listed in Connection. Keep-Alive and
+// Proxy-Connection are legacy fields of that kind,
+// and Trailer announces a chunked trailer section
+// which is not forwarded.
+bool
+is_hop_by_hop(core::string_view name) noexcept
+{
+    using urls::grammar::ci_is_equal;
+    return
+        ci_is_equal(name, "Connection") ||
+        ci_is_equal(name, "Keep-Alive") ||
+        ci_is_equal(name, "Proxy-Connection") ||
+        ci_is_equal(name, "TE") ||
+        ci_is_equal(name, "Trailer") ||
+        ci_is_equal(name, "Upgrade");
+}
+
+// Return true if `name` is one of the options
+// listed in the Connection fields of a message.
+template<class View>
+bool
+is_connection_option(
+    View const& v,
+    core::string_view name) noexcept
+{
+    using urls::grammar::ci_is_equal;
+    for(auto const& f : v)
+    {
+        if(! ci_is_equal(f.name, "Connection"))
+            continue;
+        core::string_view list = f.value;
+        for(;;)
+        {
+            auto const comma = list.find(',');
+            auto token = list.substr(0, comma);
+            while(! token.empty() &&
+                (token.front() == ' ' || token.front() == '\t'))
+                token.remove_prefix(1);
+            while(! token.empty() &&
+                (token.back() == ' ' || token.back() == '\t'))
+                token.remove_suffix(1);
+            if(ci_is_equal(token, name))
+                return true;
+            if(comma == core::string_view::npos)
+                break;
+            list.remove_prefix(comma + 1);
+        }
+    }
+    return false;
+}
+
+template<class View, class Message>
+void
+copy_fields(
+    View const& from,
+    Message& to)
+{
+    for(auto const& f : from)
+        if( ! is_hop_by_hop(f.name) &&
+            ! is_connection_option(from, f.name))
+            to.append(f.name, f.value);
+}
+
+// Move decoded body octets from a parser into
+// a serializer stream, closing the stream when
+// the message is complete.
+void
+transfer(
+    http_proto::parser& pr,
+    http_proto::serializer::stream& body,
+    bool& closed)
+{
+    for(;;)
+    {
+        auto const in = pr.pull_body();
+        if(buffers::buffer_size(in) == 0)
+            break;
+        auto const n = buffers::buffer_copy(
+            body.prepare(), in);
+        if(n == 0)
+            break;
+        body.commit(n);
+        pr.consume_body(n);
+    }
+    if( ! closed &&
+        pr.is_complete() &&
+        buffers::buffer_size(pr.pull_body()) == 0)
+    {
+        body.close();
+        closed = true;
+    }
+}
+
+// Return true if a request may be sent again after
+// an upstream failed without answering it. Only
+// safe methods qualify: the proxy cannot tell if
+// the upstream acted on the first attempt.
+bool
+is_replayable(http_proto::method m) noexcept
+{
+    switch(m)
+    {
+    case http_proto::method::get:
+    case http_proto::method::head:
+    case http_proto::method::options:
+    case http_proto::method::trace:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Return true for the errors seen when the upstream
+// closed a pooled connection while it sat idle.
+bool
+is_stale_connection(
+    boost::system::error_code const& ec) noexcept
+{
+    return
+        ec == http_proto::error::end_of_stream ||
+        ec == asio::error::eof ||
+        ec == asio::error::connection_reset ||
+        ec == asio::error::broken_pipe;
+}
+
+} // (anon)
+
+//------------------------------------------------
+
+struct proxy::connection
+{
+    socket_type sock;
+    http_proto::response_parser pr;
+    http_proto::serializer sr;
+    std::size_t up;
+
+    connection(
+        server::executor_type ex,
+        http_proto::context& ctx,
+        std::size_t up_)
+        : sock(ex)
+        , pr(ctx)
+        , sr(ctx)
+        , up(up_)
+    {
+        pr.reset();
+    }
+};
+
+proxy::
+proxy(
+    server& srv,
+    http_proto::context& ctx,
+    error_pages const& pages,
+    timer_wheel& timers,
+    config cfg)
+    : srv_(srv)
+    , ctx_(ctx)
+    , pages_(pages)
+    , timers_(timers)
+    , cfg_(std::move(cfg))
+{
+    if(cfg_.upstreams.empty())
+        throw std::invalid_argument(
+            "proxy needs at least one upstream");
+    ups_.resize(cfg_.upstreams.size());
+    for(std::size_t i = 0; i < ups_.size(); ++i)
+        ups_[i].ep = cfg_.upstreams[i];
+}
+
+proxy::
+~proxy() = default;
+
+bool
+proxy::
+matches(
+    http_proto::request_view const& req) const noexcept
+{
+    // The prefix must end on a segment boundary,
+    // so that "/api" matches "/api/v1" and "/api?x"
+    // but not "/apiary".
+    auto const t = req.target_text();
+    auto const& prefix = cfg_.prefix;
+    if(! t.starts_with(prefix))
+        return false;
+    if( t.size() == prefix.size() ||
+        prefix.empty() ||
+        prefix.back() == '/')
+        return true;
+    auto const c = t[prefix.size()];
+    return c == '/' || c == '?' || c == '#';
+}
+
+void
+proxy::
+run()
+{
+}
+
+void
+proxy::
+drain()
+{
+    for(auto& u : ups_)
+        u.idle.clear();
+}
+
+void
+proxy::
+stop()
+{
+    is_stopped_ = true;
+    drain();
+}
+
+// Least outstanding requests, ties going
+// to the first upstream in the list.
+std::size_t
+proxy::
+choose() const noexcept
+{
+    std::size_t best = 0;
+    for(std::size_t i = 1; i < ups_.size(); ++i)
+        if(ups_[i].outstanding < ups_[best].outstanding)
+            best = i;
+    return best;
+}
+
+auto
+proxy::
+acquire(
+    std::size_t up,
+    bool fresh) ->
+        std::unique_ptr<connection>
+{
+    auto& u = ups_[up];
+    if(! fresh && ! u.idle.empty())
+    {
+        auto c = std::move(u.idle.back());
+        u.idle.pop_back();
+        return c;
+    }
+    return std::unique_ptr<connection>(new
+        connection(srv_.make_executor(), ctx_, up));
+}
+
+void
+proxy::
+release(
+    std::unique_ptr<connection>& c,
+    bool reusable) noexcept
+{
+    if(! c)
+        return;
+    auto& u = ups_[c->up];
+    if( reusable &&
+        ! is_stopped_ &&
+        u.idle.size() < cfg_.max_idle)
+    {
+        u.idle.emplace_back(std::move(c));
+        return;
+    }
+    c.reset();
+}
+
+//------------------------------------------------
+
+proxy::
+exchange::
+exchange(
+    proxy& p,
+    socket_type& client,
+    timer_wheel::timer& client_deadline,
+    timer_wheel::duration read_timeout,
+    timer_wheel::duration write_timeout,
+    handler_type on_done)
+    : p_(p)
+    , client_(client)
+    , client_deadline_(client_deadline)
+    , read_timeout_(read_timeout)
+    , write_timeout_(write_timeout)
+    , on_done_(std::move(on_done))
+    , deadline_(std::bind(&exchange::on_timeout, this))
+{
+}
+
+proxy::
+exchange::
+~exchange()
+{
+    if(is_active_)
+        --p_.ups_[up_].outstanding;
+    p_.release(conn_, false);
+}
+
+void
+proxy::
+exchange::
+start(
+    http_proto::request_parser& pr,
+    http_proto::response& res,
+    http_proto::serializer& sr,
+    bool keep_alive)
+{
+    pr_ = &pr;
+    res_ = &res;
+    sr_ = &sr;
+    keep_alive_ = keep_alive;
+    bytes_read_ = 0;
+    bytes_written_ = 0;
+    retried_ = false;
+    got_reply_ = false;
+    responded_ = false;
+    timed_out_ = false;
+    is_active_ = true;
+
+    up_ = p_.choose();
+    ++p_.ups_[up_].outstanding;
+    conn_ = p_.acquire(up_, false);
+    reused_ = conn_->sock.is_open();
+    if(reused_)
+        return send_request();
+    do_connect();
+}
+
+void
+proxy::
+exchange::
+cancel() noexcept
+{
+    deadline_.cancel();
+    boost::system::error_code ec;
+    if(conn_)
+        conn_->sock.cancel(ec);
+}
+
+// Only one side is timed at once. The deadline
+// covers each upstream operation and the client
+// connection's timer each client operation, so
+// neither is charged for time spent on the other.
+void
+proxy::
+exchange::
+expires_after() noexcept
+{
+    client_deadline_.cancel();
+    p_.timers_.arm(deadline_, p_.cfg_.timeout);
+}
+
+void
+proxy::
+exchange::
+client_expires_after(
+    timer_wheel::duration d) noexcept
+{
+    deadline_.cancel();
+    p_.timers_.arm(client_deadline_, d);
+}
+
+void
+proxy::
+exchange::
+on_timeout()
+{
+    timed_out_ = true;
+    boost::system::error_code ec;
+    if(conn_)
+        conn_->sock.cancel(ec);
+}
+
+void
+proxy::
+exchange::
+do_connect()
+{
+    expires_after();
+    conn_->sock.async_connect(
+        p_.ups_[up_].ep, std::bind(
+            &exchange::on_connect, this, _1));
+}
+
+void
+proxy::
+exchange::
+on_connect(boost::system::error_code ec)
+{
+    if(ec.failed())
+        return fail_upstream(ec);
+    send_request();
+}
+
+void
+proxy::
+exchange::
+send_request()
+{
+    auto const& v = pr_->get();
+    req_.clear();
+    req_.set_start_line(
+        v.method_text(),
+        v.target_text(),
+        v.version());
+    copy_fields(v, req_);
+    req_.set_keep_alive(true);
+
+    has_up_body_ =
+        v.payload() != http_proto::payload::none;
+    up_closed_ = ! has_up_body_;
+    if(has_up_body_)
+        up_body_ = conn_->sr.start_stream(req_);
+    else
+        conn_->sr.start(req_);
+    pump_request();
+}
+
+void
+proxy::
+exchange::
+pump_request()
+{
+    if(has_up_body_)
+        transfer(*pr_, up_body_, up_closed_);
+    if(conn_->sr.is_done())
+        return read_response();
+
+    auto const rv = conn_->sr.prepare();
+    if(rv.has_value())
+    {
+        expires_after();
+        return http_io::async_write_some(
+            conn_->sock, conn_->sr, std::bind(
+                &exchange::on_request_write, this, _1, _2));
+    }
+    if(rv.error() != http_proto::error::need_data)
+        return fail_upstream(rv.error());
+
+    // The client has not sent enough of the body
+    client_expires_after(read_timeout_);
+    http_io::async_read_some(client_, *pr_, std::bind(
+        &exchange::on_request_body, this, _1, _2));
+}
+
+void
+proxy::
+exchange::
+on_request_body(
+    boost::system::error_code ec,
+    std::size_t n)
+{
+    bytes_read_ += n;
+    if(ec.failed())
+        return finish(ec);
+    pump_request();
+}
+
+void
+proxy::
+exchange::
+on_request_write(
+    boost::system::error_code ec,
+    std::size_t)
+{
+    if(ec.failed())
+        return fail_upstream(ec);
+    pump_request();
+}
+
+void
+proxy::
+exchange::
+read_response()
+{
+    if(pr_->get().method() == http_proto::method::head)
+        conn_->pr.start_head_response();
+    else
+        conn_->pr.start();
+
+    expires_after();
+    http_io::async_read_header(
+        conn_->sock, conn_->pr, std::bind(
+            &exchange::on_response_header, this, _1, _2));
+}
+
+void
+proxy::
+exchange::
+on_response_header(
+    boost::system::error_code ec,
+    std::size_t n)
+{
+    if(n != 0)
+        got_reply_ = true;
+    if(ec.failed())
+        return fail_upstream(ec);
+
+    auto const& v = conn_->pr.get();
+    res_->clear();
+    res_->set_start_line(
+        v.status_int(),
+        v.reason(),
+        v.version());
+    copy_fields(v, *res_);
+    res_->set_keep_alive(
+        keep_alive_ && pr_->get().keep_alive());
+
+    responded_ = true;
+    has_down_body_ =
+        v.payload() != http_proto::payload::none &&
+        pr_->get().method() != http_proto::method::head;
+    down_closed_ = ! has_down_body_;
+    if(has_down_body_)
+        down_body_ = sr_->start_stream(*res_);
+    else
+        sr_->start(*res_);
+    pump_response();
+}
+
+void
+proxy::
+exchange::
+pump_response()
+{
+    if(has_down_body_)
+        transfer(conn_->pr, down_body_, down_closed_);
+    if(sr_->is_done())
+        return finish({});
+
+    auto const rv = sr_->prepare();
+    if(rv.has_value())
+    {
+        client_expires_after(write_timeout_);
+        return http_io::async_write_some(
+            client_, *sr_, std::bind(
+                &exchange::on_response_write, this, _1, _2));
+    }
+    if(rv.error() != http_proto::error::need_data)
+        return finish(rv.error());
+
+    // The upstream has not sent enough of the body
+    expires_after();
+    http_io::async_read_some(
+        conn_->sock, conn_->pr, std::bind(
+            &exchange::on_response_body, this, _1, _2));
+}
+
+void
+proxy::
+exchange::
+on_response_body(
+    boost::system::error_code ec,
+    std::size_t)
+{
+    if(ec.failed())
+        return fail_upstream(ec);
+    pump_response();
+}
+
+void
+proxy::
+exchange::
+on_response_write(
+    boost::system::error_code ec,
+    std::size_t n)
+{
+    bytes_written_ += n;
+    if(ec.failed())
+        return finish(ec);
+    pump_response();
+}
+
+void
+proxy::
+exchange::
+fail_upstream(boost::system::error_code ec)
+{
+    p_.release(conn_, false);
+
+    // Cancelled by the server stopping, there is
+    // nobody left to retry for or send a page to.
+    if( ! timed_out_ &&
+        ec == asio::error::operation_aborted)
+        return finish(ec);
+
+    if(timed_out_)
+        ec = asio::error::timed_out;
+
+    // The response is cut short, the client
+    // connection must close to signal it.
+    if(responded_)
+        return finish(ec);
+
+    // A pooled connection may have been closed
+    // by the upstream while idle. Retry once on
+    // a new connection if the upstream sent none
+    // of a response and no part of the request
+    // body was consumed, unless a second attempt
+    // could repeat what the first one did.
+    if( reused_ &&
+        ! retried_ &&
+        ! got_reply_ &&
+        ! has_up_body_ &&
+        is_stale_connection(ec) &&
+        is_replayable(pr_->get().method()))
+    {
+        retried_ = true;
+        reused_ = false;
+        conn_ = p_.acquire(up_, true);
+        return do_connect();
+    }
+
+    // Close if the request body was left unread
+    responded_ = true;
+    res_->clear();
+    p_.pages_.start(
+        timed_out_ ?
+            http_proto::status::gateway_timeout :
+            http_proto::status::bad_gateway,
+        pr_->get(), *res_, *sr_, scratch_,
+        keep_alive_ && pr_->is_complete());
+    client_expires_after(write_timeout_);
+    http_io::async_write(client_, *sr_, std::bind(
+        &exchange::on_error_page, this, _1, _2));
+}
+
+void
+proxy::
+exchange::
+on_error_page(
+    boost::system::error_code ec,
+    std::size_t n)
+{
+    bytes_written_ += n;
+    finish(ec);
+}
+
+void
+proxy::
+exchange::
+finish(boost::system::error_code ec)
+{
+    deadline_.cancel();
+    client_deadline_.cancel();
+    if(conn_)
+    {
+        auto const reusable =
+            ! ec.failed() &&
+            conn_->pr.is_complete() &&
+            conn_->pr.get().keep_alive();
+        p_.release(conn_, reusable);
+    }
+    --p_.ups_[up_].outstanding;
+    is_active_ = false;
+    on_done_(ec, bytes_written_);
+}
@@ -0,0 +1,221 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_PROXY_HPP
+#define BOOST_HTTP_IO_EXAMPLE_PROXY_HPP
+
+#include "error_pages.hpp"
+#include "server.hpp"
+#include "timer_wheel.hpp"
+#include <boost/asio/basic_stream_socket.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/http_proto/context.hpp>
+#include <boost/http_proto/request.hpp>
+#include <boost/http_proto/request_parser.hpp>
+#include <boost/http_proto/response.hpp>
+#include <boost/http_proto/response_parser.hpp>
+#include <boost/http_proto/serializer.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** A reverse proxy to a set of upstream servers
+
+    Requests whose path is the configured prefix or
+    lies beneath it are forwarded to the upstream
+    with the fewest requests outstanding. Upstream
+    connections are kept alive and reused from a pool.
+
+    Bodies are streamed in both directions through
+    the parsers and serializers, so neither message
+    is ever buffered whole.
+*/
+class proxy : public server::service
+{
+public:
+    using socket_type = boost::asio::basic_stream_socket<
+        boost::asio::ip::tcp, server::executor_type>;
+
+    using handler_type = std::function<void(
+        boost::system::error_code, std::size_t)>;
+
+    struct config
+    {
+        // Targets under this path are forwarded
+        std::string prefix;
+
+        std::vector<boost::asio::ip::tcp::endpoint> upstreams;
+
+        // Idle connections kept for each upstream
+        std::size_t max_idle = 16;
+
+        // Limit on each step of the upstream exchange
+        timer_wheel::duration timeout = std::chrono::seconds(30);
+    };
+
+    class exchange;
+
+    proxy(
+        server& srv,
+        boost::http_proto::context& ctx,
+        error_pages const& pages,
+        timer_wheel& timers,
+        config cfg);
+
+    ~proxy();
+
+    /** Return `true` if a request should be forwarded
+    */
+    bool
+    matches(
+        boost::http_proto::request_view const& req) const noexcept;
+
+    void run() override;
+    void drain() override;
+    void stop() override;
+
+private:
+    struct connection;
+
+    struct upstream
+    {
+        boost::asio::ip::tcp::endpoint ep;
+        std::size_t outstanding = 0;
+        std::vector<std::unique_ptr<connection>> idle;
+    };
+
+    std::size_t choose() const noexcept;
+
+    std::unique_ptr<connection>
+    acquire(std::size_t up, bool fresh);
+
+    void
+    release(
+        std::unique_ptr<connection>& c,
+        bool reusable) noexcept;
+
+    server& srv_;
+    boost::http_proto::context& ctx_;
+    error_pages const& pages_;
+    timer_wheel& timers_;
+    config cfg_;
+    std::vector<upstream> ups_;
+    bool is_stopped_ = false;
+};
+
+//------------------------------------------------
+
+/** One forwarded request and its response
+
+    A connection owns an exchange, and reuses it
+    for each request it forwards.
+*/
+class proxy::exchange
+{
+public:
+    /** Constructor
+
+        @param client_deadline The timer of the client
+        connection. It is armed only while waiting on
+        the client, for `read_timeout` on each read of
+        the request body and `write_timeout` on each
+        write of the response.
+
+        @param on_done Called with the number of bytes
+        written to the client once the response is sent.
+        On error the client connection must be closed.
+    */
+    exchange(
+        proxy& p,
+        socket_type& client,
+        timer_wheel::timer& client_deadline,
+        timer_wheel::duration read_timeout,
+        timer_wheel::duration write_timeout,
+        handler_type on_done);
+
+    ~exchange();
+
+    /** Forward a request whose header has been read
+
+        The parser, response, and serializer belong to
+        the client connection and must remain valid
+        until the completion handler is called.
+    */
+    void
+    start(
+        boost::http_proto::request_parser& pr,
+        boost::http_proto::response& res,
+        boost::http_proto::serializer& sr,
+        bool keep_alive);
+
+    // Abandon the upstream part of the exchange
+    void
+    cancel() noexcept;
+
+    // bytes read from the client for the body
+    std::size_t
+    bytes_read() const noexcept
+    {
+        return bytes_read_;
+    }
+
+private:
+    void expires_after() noexcept;
+    void client_expires_after(timer_wheel::duration d) noexcept;
+    void on_timeout();
+    void do_connect();
+    void on_connect(boost::system::error_code ec);
+    void send_request();
+    void pump_request();
+    void on_request_body(boost::system::error_code ec, std::size_t n);
+    void on_request_write(boost::system::error_code ec, std::size_t n);
+    void read_response();
+    void on_response_header(boost::system::error_code ec, std::size_t n);
+    void pump_response();
+    void on_response_body(boost::system::error_code ec, std::size_t n);
+    void on_response_write(boost::system::error_code ec, std::size_t n);
+    void on_error_page(boost::system::error_code ec, std::size_t n);
+    void fail_upstream(boost::system::error_code ec);
+    void finish(boost::system::error_code ec);
+
+    proxy& p_;
+    socket_type& client_;
+    timer_wheel::timer& client_deadline_;
+    timer_wheel::duration read_timeout_;
+    timer_wheel::duration write_timeout_;
+    handler_type on_done_;
+    timer_wheel::timer deadline_;
+
+    boost::http_proto::request_parser* pr_ = nullptr;
+    boost::http_proto::response* res_ = nullptr;
+    boost::http_proto::serializer* sr_ = nullptr;
+
+    std::unique_ptr<connection> conn_;
+    boost::http_proto::request req_;
+    boost::http_proto::serializer::stream up_body_;
+    boost::http_proto::serializer::stream down_body_;
+    std::string scratch_;
+    std::size_t up_ = 0;
+    std::size_t bytes_read_ = 0;
+    std::size_t bytes_written_ = 0;
+    bool keep_alive_ = true;
+    bool reused_ = false;
+    bool retried_ = false;
+    bool got_reply_ = false;
+    bool has_up_body_ = false;
+    bool has_down_body_ = false;
+    bool up_closed_ = false;
+    bool down_closed_ = false;
+    bool responded_ = false;
+    bool timed_out_ = false;
+    bool is_active_ = false;
+};
+
+#endif
@@ -0,0 +1,429 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "router.hpp"
+#include <boost/assert.hpp>
+#include <map>
+#include <stdexcept>
+
+namespace core = boost::core;
+namespace http_proto = boost::http_proto;
+
+namespace {
+
+// Split the next segment off the front of `rest`.
+// `more` becomes false after the last segment.
+core::string_view
+next_segment(
+    core::string_view& rest,
+    bool& more) noexcept
+{
+    auto const pos = rest.find('/');
+    if(pos == core::string_view::npos)
+    {
+        auto const seg = rest;
+        rest = {};
+        more = false;
+        return seg;
+    }
+    auto const seg = rest.substr(0, pos);
+    rest = rest.substr(pos + 1);
+    return seg;
+}
+
+} // (anon)
+
+core::string_view
+route_params::
+operator[](core::string_view name) const noexcept
+{
+    for(std::size_t i = 0; i < size_; ++i)
+        if(v_[i].name == name)
+            return v_[i].value;
+    return {};
+}
+
+//------------------------------------------------
+
+struct router::builder
+{
+    struct node
+    {
+        std::map<std::string, std::uint32_t> statics;
+        std::uint32_t param = npos;
+        std::uint32_t wildcard = npos;
+        std::string name;
+        std::vector<route> routes;
+    };
+
+    std::vector<node> nodes;
+
+    builder()
+        : nodes(1)
+    {
+    }
+
+    // Return the capture child of node `n` through
+    // `slot`, creating it if needed. Indices are used
+    // since adding a node invalidates references.
+    std::uint32_t
+    child(
+        std::uint32_t n,
+        std::uint32_t node::* slot,
+        core::string_view name)
+    {
+        auto i = nodes[n].*slot;
+        if(i == npos)
+        {
+            i = static_cast<std::uint32_t>(nodes.size());
+            nodes.emplace_back();
+            nodes.back().name.assign(
+                name.data(), name.size());
+            nodes[n].*slot = i;
+        }
+        else if(core::string_view(nodes[i].name) != name)
+        {
+            throw std::invalid_argument(
+                "conflicting capture names");
+        }
+        return i;
+    }
+};
+
+router::
+router()
+    : build_(new builder)
+{
+}
+
+router::
+~router() = default;
+
+void
+router::
+add(
+    http_proto::method m,
+    core::string_view pattern,
+    handler h)
+{
+    add_impl(pattern, route{ m, false, 0 }, std::move(h));
+}
+
+void
+router::
+add(
+    core::string_view pattern,
+    handler h)
+{
+    add_impl(pattern,
+        route{ http_proto::method::get, true, 0 },
+        std::move(h));
+}
+
+void
+router::
+add_impl(
+    core::string_view pattern,
+    route r,
+    handler h)
+{
+    if(! build_)
+        throw std::invalid_argument(
+            "router is frozen");
+    if(pattern.empty() || pattern[0] != '/')
+        throw std::invalid_argument(
+            "pattern must begin with '/'");
+
+    auto& b = *build_;
+    std::uint32_t n = 0;
+    std::size_t captures = 0;
+    auto rest = pattern.substr(1);
+    bool more = ! rest.empty();
+    while(more)
+    {
+        auto const seg = next_segment(rest, more);
+        if(! seg.empty() && seg[0] == ':')
+        {
+            if(seg.size() == 1)
+                throw std::invalid_argument(
+                    "unnamed parameter");
+            n = b.child(n, &builder::node::param, seg.substr(1));
+            ++captures;
+        }
+        else if(! seg.empty() && seg[0] == '*')
+        {
+            if(more)
+                throw std::invalid_argument(
+                    "wildcard must be the last segment");
+            n = b.child(n, &builder::node::wildcard, seg.substr(1));
+            ++captures;
+        }
+        else
+        {
+            auto const it = b.nodes[n].statics.emplace(
+                std::string(seg.data(), seg.size()),
+                static_cast<std::uint32_t>(b.nodes.size()));
+            n = it.first->second;
+            if(it.second)
+                b.nodes.emplace_back();
+        }
+    }
+    if(captures > route_params::max_size)
+        throw std::invalid_argument(
+            "too many captures");
+
+    for(auto const& other : b.nodes[n].routes)
+        if(other.any == r.any && (r.any || other.m == r.m))
+            throw std::invalid_argument(
+                "duplicate route");
+
+    r.handler = static_cast<std::uint32_t>(handlers_.size());
+    handlers_.emplace_back(std::move(h));
+    b.nodes[n].routes.push_back(r);
+}
+
+void
+router::
+freeze()
+{
+    if(! build_)
+        return;
+    auto& b = *build_;
+
+    // Breadth-first order places the children
+    // of every node next to each other.
+    std::vector<std::uint32_t> order;
+    std::vector<std::uint32_t> index(b.nodes.size());
+    order.reserve(b.nodes.size());
+    order.push_back(0);
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        auto const& bn = b.nodes[order[i]];
+        for(auto const& e : bn.statics)
+            order.push_back(e.second);
+        if(bn.param != npos)
+            order.push_back(bn.param);
+        if(bn.wildcard != npos)
+            order.push_back(bn.wildcard);
+    }
+    for(std::size_t i = 0; i < order.size(); ++i)
+        index[order[i]] = static_cast<std::uint32_t>(i);
+
+    auto const append = [this](core::string_view s)
+    {
+        auto const offset =
+            static_cast<std::uint32_t>(chars_.size());
+        chars_.append(s.data(), s.size());
+        return offset;
+    };
+
+    nodes_.resize(order.size());
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        auto const& bn = b.nodes[order[i]];
+        auto& nd = nodes_[i];
+
+        // std::map iterates in the order which
+        // binary search in match() expects.
+        nd.first_edge = static_cast<std::uint32_t>(edges_.size());
+        nd.num_edges = static_cast<std::uint32_t>(bn.statics.size());
+        for(auto const& e : bn.statics)
+        {
+            edges_.push_back(edge{
+                append(e.first),
+                static_cast<std::uint32_t>(e.first.size()),
+                index[e.second] });
+        }
+        if(bn.param != npos)
+            nd.param = index[bn.param];
+        if(bn.wildcard != npos)
+            nd.wildcard = index[bn.wildcard];
+
+        nd.first_route = static_cast<std::uint32_t>(routes_.size());
+        nd.num_routes = static_cast<std::uint32_t>(bn.routes.size());
+        routes_.insert(routes_.end(),
+            bn.routes.begin(), bn.routes.end());
+
+        nd.name = append(bn.name);
+        nd.name_size = static_cast<std::uint32_t>(bn.name.size());
+
+        // The Allow field sent with a 405 from this node
+        std::string allow;
+        bool has_get = false;
+        bool has_head = false;
+        for(auto const& rt : bn.routes)
+        {
+            if(rt.any)
+                continue;
+            has_get = has_get || rt.m == http_proto::method::get;
+            has_head = has_head || rt.m == http_proto::method::head;
+            auto const name = http_proto::to_string(rt.m);
+            if(! allow.empty())
+                allow.append(", ");
+            allow.append(name.data(), name.size());
+        }
+        if(has_get && ! has_head)
+            allow.append(", HEAD");
+        nd.allow = append(allow);
+        nd.allow_size = static_cast<std::uint32_t>(allow.size());
+    }
+
+    nodes_.shrink_to_fit();
+    edges_.shrink_to_fit();
+    routes_.shrink_to_fit();
+    chars_.shrink_to_fit();
+    build_.reset();
+}
+
+http_proto::status
+router::
+dispatch(
+    route_params& params,
+    http_proto::request_view const& req,
+    http_proto::response& res,
+    http_proto::serializer& sr) const
+{
+    BOOST_ASSERT(! build_);
+
+    auto path = req.target_text();
+    if(path.empty() || path[0] != '/')
+        return http_proto::status::bad_request;
+    auto const q = path.find('?');
+    if(q != core::string_view::npos)
+        path = path.substr(0, q);
+
+    params.size_ = 0;
+    std::uint32_t n;
+    if( nodes_.empty() ||
+        ! match(0, path.substr(1),
+            path.size() > 1, params, n))
+        return http_proto::status::not_found;
+
+    auto const& nd = nodes_[n];
+    route const* any = nullptr;
+    route const* get = nullptr;
+    auto const first = routes_.data() + nd.first_route;
+    auto const last = first + nd.num_routes;
+    for(auto it = first; it != last; ++it)
+    {
+        if(it->any)
+        {
+            any = it;
+            continue;
+        }
+        if(it->m == req.method())
+        {
+            handlers_[it->handler](params, req, res, sr);
+            return http_proto::status::ok;
+        }
+        if(it->m == http_proto::method::get)
+            get = it;
+    }
+
+    // HEAD is GET without the body (RFC 9110 9.3.2)
+    if(get && req.method() == http_proto::method::head)
+        any = get;
+    if(! any)
+    {
+        params.allow = core::string_view(
+            chars_.data() + nd.allow, nd.allow_size);
+        return http_proto::status::method_not_allowed;
+    }
+    handlers_[any->handler](params, req, res, sr);
+    return http_proto::status::ok;
+}
+
+// Find the node matching the segments in `rest`,
+// preferring literals, then parameters, then
+// wildcards, and backtracking on failure.
+bool
+router::
+match(
+    std::uint32_t n,
+    core::string_view rest,
+    bool more,
+    route_params& params,
+    std::uint32_t& found) const noexcept
+{
+    auto const& nd = nodes_[n];
+    if(! more)
+    {
+        if(nd.num_routes != 0)
+        {
+            found = n;
+            return true;
+        }
+        if(nd.wildcard != npos)
+        {
+            capture(params, nodes_[nd.wildcard], {});
+            found = nd.wildcard;
+            return true;
+        }
+        return false;
+    }
+
+    auto const whole = rest;
+    auto const seg = next_segment(rest, more);
+
+    // binary search the literal edges
+    auto lo = edges_.data() + nd.first_edge;
+    auto hi = lo + nd.num_edges;
+    while(lo < hi)
+    {
+        auto const mid = lo + (hi - lo) / 2;
+        auto const cmp = core::string_view(
+            chars_.data() + mid->offset,
+                mid->size).compare(seg);
+        if(cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else if(cmp > 0)
+        {
+            hi = mid;
+        }
+        else
+        {
+            if(match(mid->node, rest, more, params, found))
+                return true;
+            break;
+        }
+    }
+
+    if(nd.param != npos && ! seg.empty())
+    {
+        auto const size = params.size_;
+        capture(params, nodes_[nd.param], seg);
+        if(match(nd.param, rest, more, params, found))
+            return true;
+        params.size_ = size;
+    }
+
+    if(nd.wildcard != npos)
+    {
+        capture(params, nodes_[nd.wildcard], whole);
+        found = nd.wildcard;
+        return true;
+    }
+    return false;
+}
+
+void
+router::
+capture(
+    route_params& params,
+    node const& nd,
+    core::string_view value) const noexcept
+{
+    BOOST_ASSERT(params.size_ < route_params::max_size);
+    auto& p = params.v_[params.size_++];
+    p.name = core::string_view(
+        chars_.data() + nd.name, nd.name_size);
+    p.value = value;
+}
@@ -0,0 +1,213 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_ROUTER_HPP
+#define BOOST_HTTP_IO_EXAMPLE_ROUTER_HPP
+
+#include <boost/core/detail/string_view.hpp>
+#include <boost/http_proto/method.hpp>
+#include <boost/http_proto/request_view.hpp>
+#include <boost/http_proto/response.hpp>
+#include <boost/http_proto/serializer.hpp>
+#include <boost/http_proto/status.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Values passed to a route handler
+*/
+class route_params
+{
+public:
+    static constexpr std::size_t max_size = 8;
+
+    // Caller-owned storage for a dynamic body. It
+    // must remain unmodified until the serializer
+    // is done.
+    std::string* scratch = nullptr;
+
+    // `false` if the connection must close after
+    // the response regardless of the request.
+    bool keep_alive = true;
+
+    // Set by @ref router::dispatch when it returns
+    // `status::method_not_allowed`, the value of
+    // the Allow field to send with the error.
+    boost::core::string_view allow;
+
+    // number of captured segments
+    std::size_t
+    size() const noexcept
+    {
+        return size_;
+    }
+
+    boost::core::string_view
+    name(std::size_t i) const noexcept
+    {
+        return v_[i].name;
+    }
+
+    boost::core::string_view
+    value(std::size_t i) const noexcept
+    {
+        return v_[i].value;
+    }
+
+    /** Return a capture by name, or an empty string
+    */
+    boost::core::string_view
+    operator[](boost::core::string_view name) const noexcept;
+
+private:
+    friend class router;
+
+    struct param
+    {
+        boost::core::string_view name;
+        boost::core::string_view value;
+    };
+
+    param v_[max_size];
+    std::size_t size_ = 0;
+};
+
+//------------------------------------------------
+
+/** A request router
+
+    Routes are patterns of path segments. A segment
+    is either literal text, a parameter ":name" which
+    captures one non-empty segment, or, in the last
+    position only, a wildcard "*name" which captures
+    the rest of the path including slashes. Literal
+    segments take precedence over parameters, which
+    take precedence over wildcards.
+
+    Routes are added to a trie of segments, which
+    @ref freeze compiles into flat arrays laid out
+    breadth-first, with the literal edges of each
+    node sorted for binary search. Dispatching
+    never allocates.
+*/
+class router
+{
+public:
+    using handler = std::function<void(
+        route_params const&,
+        boost::http_proto::request_view const&,
+        boost::http_proto::response&,
+        boost::http_proto::serializer&)>;
+
+    router();
+    ~router();
+
+    /** Add a route for one method
+
+        @throws std::invalid_argument The pattern is
+        malformed, already has a handler for the
+        method, or the router is frozen.
+    */
+    void
+    add(
+        boost::http_proto::method m,
+        boost::core::string_view pattern,
+        handler h);
+
+    /** Add a route for every method
+    */
+    void
+    add(
+        boost::core::string_view pattern,
+        handler h);
+
+    /** Compile the routes
+
+        No routes may be added afterwards.
+    */
+    void
+    freeze();
+
+    /** Invoke the handler matching a request
+
+        A HEAD request is given to the GET handler of
+        a route without one for HEAD, and the handler
+        must leave out the body.
+
+        @return `status::ok` if a handler was invoked.
+        Otherwise the error to respond with, and the
+        response and serializer are untouched.
+    */
+    boost::http_proto::status
+    dispatch(
+        route_params& params,
+        boost::http_proto::request_view const& req,
+        boost::http_proto::response& res,
+        boost::http_proto::serializer& sr) const;
+
+private:
+    static constexpr std::uint32_t npos = ~std::uint32_t(0);
+
+    struct builder;
+
+    struct edge
+    {
+        std::uint32_t offset;   // into chars_
+        std::uint32_t size;
+        std::uint32_t node;
+    };
+
+    struct route
+    {
+        boost::http_proto::method m;
+        bool any;
+        std::uint32_t handler;
+    };
+
+    struct node
+    {
+        std::uint32_t first_edge = 0;
+        std::uint32_t num_edges = 0;
+        std::uint32_t param = npos;     // child node
+        std::uint32_t wildcard = npos;  // child node
+        std::uint32_t first_route = 0;
+        std::uint32_t num_routes = 0;
+        std::uint32_t name = 0;         // capture name in chars_
+        std::uint32_t name_size = 0;
+        std::uint32_t allow = 0;        // Allow value in chars_
+        std::uint32_t allow_size = 0;
+    };
+
+    void add_impl(
+        boost::core::string_view pattern,
+        route r, handler h);
+
+    bool match(
+        std::uint32_t n,
+        boost::core::string_view rest,
+        bool more,
+        route_params& params,
+        std::uint32_t& found) const noexcept;
+
+    void capture(
+        route_params& params,
+        node const& nd,
+        boost::core::string_view value) const noexcept;
+
+    std::vector<node> nodes_;
+    std::vector<edge> edges_;
+    std::vector<route> routes_;
+    std::vector<handler> handlers_;
+    std::string chars_;
+    std::unique_ptr<builder> build_;
+};
+
+#endif
@@ -8,6 +8,7 @@
 //
 
 #include "server.hpp"
+#include <boost/assert.hpp>
 #include <functional>
 
 server::
@@ -63,6 +64,15 @@ stop()
         svc->stop();
 }
 
+void
+server::
+remove_connection()
+{
+    BOOST_ASSERT(connections_ > 0);
+    if(--connections_ == 0 && is_shutting_down_)
+        stop();
+}
+
 void
 server::
 on_signal(
@@ -72,7 +82,8 @@ on_signal(
 
     if(! is_shutting_down_)
     {
-        // new requests will receive HTTP 503 status
+        // stop accepting, close idle connections,
+        // and send Connection: close on the rest
         is_shutting_down_ = true;
 
         // begin timed, graceful shutdown
@@ -82,6 +93,13 @@ on_signal(
         timer_.expires_after(std::chrono::seconds(30));
         timer_.async_wait(std::bind(
             &server::on_timer, this, _1));
+
+        for(auto& svc : v_)
+            svc->drain();
+
+        // nothing was in flight
+        if(connections_ == 0)
+            stop();
     }
     else
     {
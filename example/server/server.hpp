@@ -29,6 +29,11 @@ public:
         virtual ~service() = default;
         virtual void run() = 0;
         virtual void stop() = 0;
+
+        // Called once when a graceful shutdown begins.
+        // Services should stop taking new work and
+        // release anything which is idle.
+        virtual void drain() {}
     };
 
     server();
@@ -48,6 +53,24 @@ public:
         return is_shutting_down_;
     }
 
+    /** Connection accounting
+
+        Services report each connection they open
+        and close. Once shutting down, the server
+        stops as soon as the last one closes.
+    */
+    void add_connection() noexcept
+    {
+        ++connections_;
+    }
+
+    void remove_connection();
+
+    std::size_t connections() const noexcept
+    {
+        return connections_;
+    }
+
 private:
     void on_signal(boost::system::error_code const&, int);
     void on_timer(boost::system::error_code const&);
@@ -59,6 +82,7 @@ private:
         boost::asio::wait_traits<std::chrono::steady_clock>,
         executor_type> timer_;
     std::vector<std::unique_ptr<service>> v_;
+    std::size_t connections_ = 0;
     bool is_shutting_down_ = false;
     bool is_stopped_ = false;
 };
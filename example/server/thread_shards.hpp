@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_THREAD_SHARDS_HPP
+#define BOOST_HTTP_IO_EXAMPLE_THREAD_SHARDS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** One default-constructed `T` for each thread
+
+    A thread's shard is created on its first call to
+    @ref local and found through a thread-local cache
+    afterwards, so only the first call locks.
+
+    The cache is keyed on a serial number which is
+    never reused, rather than on the address of the
+    owner, so an instance created where a destroyed
+    one lived can't be handed the old one's shard.
+*/
+template<class T>
+class thread_shards
+{
+    struct entry
+    {
+        std::thread::id owner;
+        T value;
+    };
+
+    static
+    std::uint64_t
+    next_serial() noexcept
+    {
+        static std::atomic<std::uint64_t> n{0};
+        return n.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    std::uint64_t const serial_ = next_serial();
+    mutable std::mutex m_;
+    std::vector<std::unique_ptr<entry>> v_;
+
+public:
+    /** Return the shard of the calling thread
+    */
+    T&
+    local()
+    {
+        // zero-initialized, as it has static storage
+        struct cache
+        {
+            std::uint64_t serial;
+            T* t;
+        };
+        static thread_local cache c;
+        if(c.serial == serial_)
+            return *c.t;
+
+        // First use on this thread, or the thread
+        // last used a different instance.
+        auto const id = std::this_thread::get_id();
+        std::lock_guard<std::mutex> lock(m_);
+        for(auto& p : v_)
+        {
+            if(p->owner == id)
+            {
+                c = { serial_, &p->value };
+                return p->value;
+            }
+        }
+        v_.emplace_back(new entry);
+        v_.back()->owner = id;
+        c = { serial_, &v_.back()->value };
+        return *c.t;
+    }
+
+    /** Call `f` with every shard, holding the lock
+
+        Shards are never destroyed before the
+        container, so the references stay valid.
+    */
+    template<class F>
+    void
+    for_each(F&& f)
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        for(auto& p : v_)
+            f(p->value);
+    }
+
+    template<class F>
+    void
+    for_each(F&& f) const
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        for(auto const& p : v_)
+            f(static_cast<T const&>(p->value));
+    }
+};
+
+#endif
@@ -0,0 +1,195 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#include "timer_wheel.hpp"
+
+void
+timer_wheel::
+timer::
+unlink() noexcept
+{
+    if(! next_)
+        return;
+    prev_->next_ = next_;
+    next_->prev_ = prev_;
+    prev_ = nullptr;
+    next_ = nullptr;
+}
+
+//------------------------------------------------
+
+// Move every node of the list headed
+// by `from` to the empty list `to`.
+void
+timer_wheel::
+splice(timer& from, timer& to) noexcept
+{
+    if(from.next_ == &from)
+        return;
+    to.next_ = from.next_;
+    to.prev_ = from.prev_;
+    to.next_->prev_ = &to;
+    to.prev_->next_ = &to;
+    from.next_ = &from;
+    from.prev_ = &from;
+}
+
+timer_wheel::
+timer_wheel(
+    server& srv,
+    duration resolution)
+    : tick_(srv.make_executor())
+    , resolution_(resolution)
+    , epoch_(clock_type::now())
+{
+    for(auto& level : wheel_)
+    {
+        for(auto& head : level)
+        {
+            head.prev_ = &head;
+            head.next_ = &head;
+        }
+    }
+}
+
+timer_wheel::
+~timer_wheel()
+{
+    // Detach armed timers so their
+    // destructors do not touch the slots.
+    for(auto& level : wheel_)
+        for(auto& head : level)
+            while(head.next_ != &head)
+                head.next_->unlink();
+}
+
+void
+timer_wheel::
+arm(timer& t, duration after) noexcept
+{
+    t.unlink();
+    auto ticks = (after + resolution_ - duration(1)) / resolution_;
+    if(ticks < 0)
+        ticks = 0;
+    t.expiry_ = base_ + static_cast<std::uint64_t>(ticks);
+    insert(t);
+}
+
+void
+timer_wheel::
+run()
+{
+    epoch_ = clock_type::now();
+    tick_.expires_at(epoch_ + resolution_);
+    tick_.async_wait(std::bind(
+        &timer_wheel::on_tick, this,
+        std::placeholders::_1));
+}
+
+void
+timer_wheel::
+stop()
+{
+    is_stopped_ = true;
+    tick_.cancel();
+}
+
+void
+timer_wheel::
+insert(timer& t) noexcept
+{
+    if(t.expiry_ < base_)
+        t.expiry_ = base_;
+
+    auto const delta = t.expiry_ - base_;
+    unsigned level = 0;
+    while(level < levels - 1 &&
+        delta >= (std::uint64_t(1) << (slot_bits * (level + 1))))
+        ++level;
+
+    // clamp to the range of the outermost wheel
+    auto const range =
+        std::uint64_t(1) << (slot_bits * levels);
+    if(delta >= range)
+        t.expiry_ = base_ + range - 1;
+
+    auto& head = wheel_[level][
+        (t.expiry_ >> (slot_bits * level)) & slot_mask];
+    t.prev_ = head.prev_;
+    t.next_ = &head;
+    head.prev_->next_ = &t;
+    head.prev_ = &t;
+}
+
+// Redistribute the current slot of an outer
+// wheel into the inner wheels. Returns `true`
+// if the next wheel out must also cascade.
+bool
+timer_wheel::
+cascade(unsigned level) noexcept
+{
+    auto const index =
+        (base_ >> (slot_bits * level)) & slot_mask;
+    timer list;
+    list.prev_ = &list;
+    list.next_ = &list;
+    splice(wheel_[level][index], list);
+    while(list.next_ != &list)
+    {
+        auto& t = *list.next_;
+        t.unlink();
+        insert(t);
+    }
+    return index == 0;
+}
+
+// Process the tick at `base_`
+void
+timer_wheel::
+advance()
+{
+    auto const index = base_ & slot_mask;
+    if(index == 0 && cascade(1) && cascade(2))
+        cascade(3);
+    ++base_;
+
+    // Handlers may arm or cancel any timer,
+    // including ones which are still pending
+    // in this list, so pop one at a time.
+    timer expired;
+    expired.prev_ = &expired;
+    expired.next_ = &expired;
+    splice(wheel_[0][index], expired);
+    while(expired.next_ != &expired)
+    {
+        auto& t = *expired.next_;
+        t.unlink();
+        t.handler_();
+    }
+}
+
+void
+timer_wheel::
+on_tick(
+    boost::system::error_code const& ec)
+{
+    if(ec.failed() || is_stopped_)
+        return;
+
+    auto const now = static_cast<std::uint64_t>(
+        (clock_type::now() - epoch_) / resolution_);
+    while(base_ <= now)
+        advance();
+
+    tick_.expires_at(epoch_ + resolution_ *
+        static_cast<duration::rep>(base_));
+    tick_.async_wait(std::bind(
+        &timer_wheel::on_tick, this,
+        std::placeholders::_1));
+}
@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2022 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/CPPAlliance/http_io
+//
+
+#ifndef BOOST_HTTP_IO_EXAMPLE_TIMER_WHEEL_HPP
+#define BOOST_HTTP_IO_EXAMPLE_TIMER_WHEEL_HPP
+
+#include "server.hpp"
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+/** A hierarchical timing wheel
+
+    This service tracks a large number of coarse
+    deadlines using a single reactor timer. Arming
+    and cancelling a timer is O(1): each timer is an
+    intrusive list node which is linked into a slot
+    of one of four wheels of 64 slots each. Timers
+    far in the future are kept in the outer wheels
+    and cascade inward as time advances.
+
+    Timers are linked into the wheel without any
+    locking, so a timer may only be armed, cancelled
+    or destroyed on the server's thread, where its
+    handler also runs.
+*/
+class timer_wheel : public server::service
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using duration = clock_type::duration;
+
+    /** A deadline which can be armed on a wheel
+
+        The handler is invoked on the server's thread
+        when the deadline is reached, unless the timer
+        was cancelled or re-armed first.
+    */
+    class timer
+    {
+        friend class timer_wheel;
+
+        timer* prev_ = nullptr;
+        timer* next_ = nullptr;
+        std::uint64_t expiry_ = 0;
+        std::function<void()> handler_;
+
+        void unlink() noexcept;
+
+    public:
+        timer() = default;
+
+        explicit
+        timer(std::function<void()> handler)
+            : handler_(std::move(handler))
+        {
+        }
+
+        timer(timer const&) = delete;
+        timer& operator=(timer const&) = delete;
+
+        ~timer()
+        {
+            unlink();
+        }
+
+        bool
+        is_armed() const noexcept
+        {
+            return next_ != nullptr;
+        }
+
+        /** Disarm the timer without invoking the handler
+        */
+        void
+        cancel() noexcept
+        {
+            unlink();
+        }
+    };
+
+    /** Constructor
+
+        @param resolution The length of one tick.
+        Deadlines are rounded up to a whole tick.
+    */
+    timer_wheel(
+        server& srv,
+        duration resolution =
+            std::chrono::milliseconds(250));
+
+    ~timer_wheel();
+
+    /** Arm or re-arm a timer
+
+        Any previous deadline is replaced.
+    */
+    void
+    arm(timer& t, duration after) noexcept;
+
+    void run() override;
+    void stop() override;
+
+private:
+    static constexpr unsigned levels = 4;
+    static constexpr unsigned slot_bits = 6;
+    static constexpr unsigned slots = 1u << slot_bits;
+    static constexpr std::uint64_t slot_mask = slots - 1;
+
+    static void splice(timer& from, timer& to) noexcept;
+    void insert(timer& t) noexcept;
+    bool cascade(unsigned level) noexcept;
+    void advance();
+    void on_tick(boost::system::error_code const&);
+
+    boost::asio::basic_waitable_timer<
+        clock_type,
+        boost::asio::wait_traits<clock_type>,
+        server::executor_type> tick_;
+    duration resolution_;
+    clock_type::time_point epoch_;
+    std::uint64_t base_ = 0;
+    bool is_stopped_ = false;
+
+    // slot heads are sentinels of circular lists
+    timer wheel_[levels][slots];
+};
+
+#endif